@@ -20,9 +20,19 @@ game game_new(constraint *constraints, color *colors) {
       g->neigh = FULL;
       g->history = NULL;  // Initially no history
       g->history_size = 0;
-      g->current_move = -1;           // No moves made yet
-      g->played_moves = queue_new();  // Create the played moves queue
-      g->undone_moves = queue_new();  // Create the undone moves queue
+      g->current_move = 0;  // No moves made yet
+      g->history_capacity = 0;
+      g->snapshots = NULL;
+      g->nb_snapshots = 0;
+      g->first_snapshot = 0;
+      g->snapshot_capacity = 0;
+      g->version = NULL;
+      g->dirty = NULL;
+      g->dirty_list = NULL;
+      g->nb_dirty = 0;
+      g->neighbors = neighbor_table_acquire(g->row, g->column, g->wrapping,
+                                            g->neigh);
+      g->kernels = game_kernels_select(g->neigh);
       g->constraints = malloc(g->row * g->column * sizeof(constraint));
       g->colors = malloc(g->row * g->column * sizeof(color));
       if (g->colors != NULL && g->constraints != NULL) {
@@ -43,9 +53,19 @@ game game_new(constraint *constraints, color *colors) {
     g->neigh = FULL;
     g->history = NULL;  // Initially no history
     g->history_size = 0;
-    g->current_move = -1;           // No moves made yet
-    g->played_moves = queue_new();  // Create the played moves queue
-    g->undone_moves = queue_new();  // Create the undone moves queue
+    g->current_move = 0;  // No moves made yet
+    g->history_capacity = 0;
+    g->snapshots = NULL;
+    g->nb_snapshots = 0;
+    g->first_snapshot = 0;
+    g->snapshot_capacity = 0;
+    g->version = NULL;
+    g->dirty = NULL;
+    g->dirty_list = NULL;
+    g->nb_dirty = 0;
+    g->neighbors = neighbor_table_acquire(g->row, g->column, g->wrapping,
+                                          g->neigh);
+    g->kernels = game_kernels_select(g->neigh);
 
     g->constraints = malloc(g->row * g->column * sizeof(constraint));
     g->colors = malloc(g->row * g->column * sizeof(color));
@@ -75,9 +95,19 @@ game game_new_empty(void) {
     g->neigh = FULL;
     g->history = NULL;  // Initially no history
     g->history_size = 0;
-    g->current_move = -1;           // No moves made yet
-    g->played_moves = queue_new();  // Create the played moves queue
-    g->undone_moves = queue_new();
+    g->current_move = 0;  // No moves made yet
+    g->history_capacity = 0;
+    g->snapshots = NULL;
+    g->nb_snapshots = 0;
+    g->first_snapshot = 0;
+    g->snapshot_capacity = 0;
+    g->version = NULL;
+    g->dirty = NULL;
+    g->dirty_list = NULL;
+    g->nb_dirty = 0;
+    g->neighbors = neighbor_table_acquire(g->row, g->column, g->wrapping,
+                                          g->neigh);
+    g->kernels = game_kernels_select(g->neigh);
     g->constraints = malloc(g->row * g->column * sizeof(constraint));
     g->colors = malloc(g->row * g->column * sizeof(color));
     if (g->colors != NULL && g->constraints != NULL) {
@@ -111,9 +141,18 @@ game game_copy(cgame g) {
     copy->neigh = FULL;
     copy->history = NULL;  // Initially no history
     copy->history_size = 0;
-    copy->current_move = -1;           // No moves made yet
-    copy->played_moves = queue_new();  // Create the played moves queue
-    copy->undone_moves = queue_new();
+    copy->current_move = 0;  // No moves made yet
+    copy->history_capacity = 0;
+    copy->snapshots = NULL;
+    copy->nb_snapshots = 0;
+    copy->first_snapshot = 0;
+    copy->snapshot_capacity = 0;
+    copy->version = NULL;
+    copy->dirty = NULL;
+    copy->dirty_list = NULL;
+    copy->nb_dirty = 0;
+    copy->neighbors = neighbor_table_ref(g->neighbors);
+    copy->kernels = g->kernels;
     copy->constraints = malloc(copy->row * copy->column * sizeof(constraint));
     copy->colors = malloc(copy->row * copy->column * sizeof(color));
     if (copy->colors != NULL && copy->constraints != NULL) {
@@ -159,8 +198,11 @@ void game_delete(game g) {
     free(g->constraints);
     free(g->colors);
     free(g->history);
-    queue_free(g->played_moves);
-    queue_free(g->undone_moves);
+    free(g->snapshots);
+    snapshot_release(g->version);
+    free(g->dirty);
+    free(g->dirty_list);
+    neighbor_table_release(g->neighbors);
     free(g);
   }
 }
@@ -176,6 +218,8 @@ void game_set_constraint(game g, uint i, uint j, constraint n) {
 void game_set_color(game g, uint i, uint j, color c) {
   if (g != NULL && i < g->row && j < g->column) {
     g->colors[i * g->column + j] = c;
+    game_touch(g, i * g->column + j);
+    game_forget_snapshots(g);
   } else {
     exit(EXIT_FAILURE);
   }
@@ -205,31 +249,15 @@ bool game_get_next_square(cgame g, uint i, uint j, direction dir, uint *pi_next,
     exit(EXIT_FAILURE);
   }
 
-  int ni = i, nj = j;
-
-  switch (dir) {
-    case UP:
-      ni = i > 0 ? i - 1 : (g->wrapping ? g->row - 1 : -1);
-      break;
-    case DOWN:
-      ni = i < g->row - 1 ? i + 1 : (g->wrapping ? 0 : -1);
-      break;
-    case LEFT:
-      nj = j > 0 ? j - 1 : (g->wrapping ? g->column - 1 : -1);
-      break;
-    case RIGHT:
-      nj = j < g->column - 1 ? j + 1 : (g->wrapping ? 0 : -1);
-      break;
-    case UP_LEFT:
-    case UP_RIGHT:
-    case DOWN_LEFT:
-    case DOWN_RIGHT:
-    case HERE:
-    default:
-      break;
-  }
+  // row and column moves of each direction, in the order of the enumeration
+  static const int DELTA_I[] = {0, -1, 1, 0, 0, -1, -1, 1, 1};
+  static const int DELTA_J[] = {0, 0, 0, -1, 1, -1, 1, -1, 1};
+  if (dir > DOWN_RIGHT) return false;
 
-  if (ni < 0 || nj < 0 || ni >= g->row || nj >= g->column) {
+  const neighbor_table *t = g->neighbors;
+  uint ni = t->row_step[(DELTA_I[dir] + 1) * g->row + i];
+  uint nj = t->col_step[(DELTA_J[dir] + 1) * g->column + j];
+  if (ni == NO_SQUARE || nj == NO_SQUARE) {
     return false;
   }
 
@@ -255,110 +283,25 @@ uint game_cols(cgame g) {
 }
 
 int game_nb_neighbors(cgame g, uint i, uint j, color c) {
-  int count = 0;
-  neighbourhood nh_type = g->neigh;
-  bool wrapping = g->wrapping;  // Check if wrapping is enabled
-
-  for (int x = -1; x <= 1; x++) {
-    for (int y = -1; y <= 1; y++) {
-      if ((nh_type == FULL_EXCLUDE || nh_type == ORTHO_EXCLUDE) && x == 0 &&
-          y == 0)
-        continue;
-      if ((nh_type == ORTHO || nh_type == ORTHO_EXCLUDE) && x != 0 && y != 0)
-        continue;
-
-      int ni = i + x;
-      int nj = j + y;
-
-      // Apply wrapping if enabled
-      if (wrapping) {
-        ni = (ni + g->row) % g->row;
-        nj = (nj + g->column) % g->column;
-      } else {
-        // Skip neighbors outside the grid if wrapping is not enabled
-        if (ni < 0 || ni >= g->row || nj < 0 || nj >= g->column) continue;
-      }
-
-      if (game_get_color(g, ni, nj) == c) {
-        count++;
-      }
-    }
-  }
-  return count;
+  return g->kernels->nb_neighbors(g, i, j, c);
 }
 
 int game_max_neighbors(cgame g, uint i, uint j) {
-  bool wrapping = g->wrapping;
-  int max_neigh;
-
-  if (wrapping) {
-    // All cells have 9 neighbors when wrapping is enabled
-    max_neigh = 9;
-  } else {
-    // Count neighbors for cells at edges or corners
-    int row = g->row - 1;
-    int column = g->column - 1;
-
-    if ((i == 0 || i == row) && (j == 0 || j == column)) {
-      // Corner cells
-      max_neigh = 4;
-    } else if (i == 0 || i == row || j == 0 || j == column) {
-      // Cells at the edges
-      max_neigh = 6;
-    } else {
-      // Cells not at the edges or corners
-      max_neigh = 9;
-    }
-  }
-  return max_neigh;
+  // size of the window, which depends on the neighbourhood and on the edges
+  uint buffer[9], nb;
+  neighbor_list(g->neighbors, i, j, buffer, &nb);
+  return nb;
 }
-int count_neighbors_of_color(cgame g, uint i, uint j, color c) {
-  int count = 0;
-  bool wrapping = g->wrapping;  // Check if wrapping is enabled
-
-  for (int x = -1; x <= 1; x++) {
-    for (int y = -1; y <= 1; y++) {
-      int ni = i + x;
-      int nj = j + y;
-
-      if (wrapping) {
-        // Adjust indices for wrapping
-        ni = (ni + g->row) % g->row;
-        nj = (nj + g->column) % g->column;
-      } else {
-        // Check for boundaries of the grid
-        if (ni < 0 || ni >= g->row || nj < 0 || nj >= g->column) continue;
-      }
 
-      if (game_get_color(g, ni, nj) == c) count++;
-    }
-  }
-
-  return count;
+int count_neighbors_of_color(cgame g, uint i, uint j, color c) {
+  return game_nb_neighbors(g, i, j, c);
 }
 
 status game_get_status(cgame g, uint i, uint j) {
-  constraint cnt = game_get_constraint(g, i, j);
-
-  if (cnt == UNCONSTRAINED) {
-    if (game_nb_neighbors(g, i, j, EMPTY) == 0) {
-      return SATISFIED;
-    }
-    return UNSATISFIED;
+  if (g == NULL || i >= g->row || j >= g->column) {
+    exit(EXIT_FAILURE);
   }
-
-  int blackNeighbors = game_nb_neighbors(g, i, j, BLACK);
-
-  if (blackNeighbors > cnt) {
-    return ERROR;
-  } else if (blackNeighbors < cnt && game_nb_neighbors(g, i, j, EMPTY) == 0) {
-    return ERROR;
-  } else if (blackNeighbors < cnt && game_nb_neighbors(g, i, j, EMPTY) != 0) {
-    return UNSATISFIED;
-  } else if (blackNeighbors == cnt && game_nb_neighbors(g, i, j, EMPTY) == 0) {
-    return SATISFIED;
-  } else
-    return SATISFIED;
+  return g->kernels->status(g, i, j);
 }
 
 void game_play_move(game g, uint i, uint j, color c) {
@@ -372,21 +315,51 @@ void game_play_move(game g, uint i, uint j, color c) {
     return;
   }
 
-  move_t *move = malloc(sizeof(move_t));
+  // A new move drops the undone ones, which can no longer be redone
+  size_t index = g->current_move;
+  if (index == g->history_capacity) {
+    size_t capacity = g->history_capacity ? 2 * g->history_capacity : 64;
+    move_t *history = realloc(g->history, capacity * sizeof(move_t));
+    if (history == NULL) {
+      fprintf(stderr, "Allocation mémoire échouée\n");
+      exit(EXIT_FAILURE);
+    }
+    g->history = history;
+    g->history_capacity = capacity;
+  }
+
+  // Snapshot the board before every K-th move, for game_goto
+  size_t nb_squares = g->row * g->column;
+  size_t period = snapshot_period(g);
+  size_t slot = index / period;
+  if (index % period == 0) {
+    if (slot == g->snapshot_capacity) {
+      size_t capacity = g->snapshot_capacity ? 2 * g->snapshot_capacity : 4;
+      color *snapshots =
+          realloc(g->snapshots, capacity * nb_squares * sizeof(color));
+      if (snapshots == NULL) {
+        fprintf(stderr, "Allocation mémoire échouée\n");
+        exit(EXIT_FAILURE);
+      }
+      g->snapshots = snapshots;
+      g->snapshot_capacity = capacity;
+    }
+    memcpy(g->snapshots + slot * nb_squares, g->colors,
+           nb_squares * sizeof(color));
+    if (g->first_snapshot > slot) g->first_snapshot = slot;
+  }
+  g->nb_snapshots = slot + 1;
+
+  move_t *move = &g->history[index];
   move->i = i;
   move->j = j;
-  move->previous_color =
-      g->colors[i * g->column + j];  // Assuming this accesses the current color
+  move->previous_color = g->colors[i * g->column + j];
   move->applied_color = c;
 
   // Apply the move to the game
   g->colors[i * g->column + j] = c;
-
-  // Add the move to the end of the played_moves queue
-  queue_push_tail(g->played_moves, move);
-
-  // Clear the undone_moves queue as a new move invalidates the redo history
-  queue_clear_full(g->undone_moves, free);
+  game_touch(g, i * g->column + j);
+  g->history_size = g->current_move = index + 1;
 }
 
 bool game_won(cgame g) {
@@ -416,6 +389,9 @@ void game_restart(game g) {
       g->colors[i * g->column + j] = EMPTY;
     }
   }
-  queue_clear(g->played_moves);
-  queue_clear(g->undone_moves);
+  game_touch_all(g);
+  g->history_size = 0;
+  g->current_move = 0;
+  g->nb_snapshots = 0;
+  g->first_snapshot = 0;
 }
@@ -0,0 +1,396 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "grid.h"
+#include "rng.h"
+#include "snapshot.h"
+
+#define MAX_SAMPLES 51
+#define MIN_SAMPLES 5
+#define SAMPLE_NS 200000.0   // target duration of one sample
+#define BENCH_NS 200000000.0  // target duration of one benchmark
+#define NB_COUNTERS 4
+#define CHECK_BATCH 64  // candidates per game_check_solutions call
+
+/* ******************** benchmark state ******************** */
+
+typedef struct {
+  game g;         // solved game (all squares colored)
+  game puzzle;    // same game without colors
+  uint nb_rows, nb_cols;
+  uint next;      // next square to visit, cycles over the grid
+  char *tmpfile;  // scratch file for load/save
+  uint8_t *packed;  // CHECK_BATCH packed copies of the solution
+  status *statuses;  // one per square, for game_status_grid
+  volatile uint64_t sink;  // keeps results alive
+} bench_ctx;
+
+typedef void (*bench_fn)(bench_ctx *ctx);
+
+static inline void next_square(bench_ctx *ctx, uint *i, uint *j) {
+  *i = ctx->next / ctx->nb_cols;
+  *j = ctx->next % ctx->nb_cols;
+  if (++ctx->next == ctx->nb_rows * ctx->nb_cols) ctx->next = 0;
+}
+
+static void bench_won(bench_ctx *ctx) { ctx->sink += game_won(ctx->g); }
+
+static void bench_get_status(bench_ctx *ctx) {
+  uint i, j;
+  next_square(ctx, &i, &j);
+  ctx->sink += game_get_status(ctx->g, i, j);
+}
+
+static void bench_nb_neighbors(bench_ctx *ctx) {
+  uint i, j;
+  next_square(ctx, &i, &j);
+  ctx->sink += game_nb_neighbors(ctx->g, i, j, BLACK);
+}
+
+static void bench_play_undo(bench_ctx *ctx) {
+  uint i, j;
+  next_square(ctx, &i, &j);
+  game_play_move(ctx->g, i, j, WHITE);
+  game_undo(ctx->g);
+}
+
+static void bench_undo_redo(bench_ctx *ctx) {
+  game_undo(ctx->g);
+  game_redo(ctx->g);
+}
+
+static void bench_copy(bench_ctx *ctx) { game_delete(game_copy(ctx->g)); }
+
+static void bench_snapshot(bench_ctx *ctx) {
+  // the first version is still held, so the second one copies a tile
+  uint i, j;
+  next_square(ctx, &i, &j);
+  snapshot before = game_snapshot(ctx->g);
+  game_play_move(ctx->g, i, j, WHITE);
+  snapshot after = game_snapshot(ctx->g);
+  game_undo(ctx->g);
+  snapshot_release(before);
+  snapshot_release(after);
+}
+
+static void bench_check_solutions(bench_ctx *ctx) {
+  bool ok[CHECK_BATCH];
+  ctx->sink +=
+      game_check_solutions(ctx->puzzle, ctx->packed, CHECK_BATCH, ok);
+}
+
+static void bench_status_grid(bench_ctx *ctx) {
+  game_status_grid(ctx->g, ctx->statuses);
+  ctx->sink += ctx->statuses[0];
+}
+
+static void bench_save_load(bench_ctx *ctx) {
+  game_save(ctx->g, ctx->tmpfile);
+  game_delete(game_load(ctx->tmpfile));
+}
+
+static void bench_solve(bench_ctx *ctx) {
+  game g = game_copy(ctx->puzzle);
+  ctx->sink += game_solve(g);
+  game_delete(g);
+}
+
+static void bench_nb_solutions(bench_ctx *ctx) {
+  ctx->sink += game_nb_solutions(ctx->puzzle);
+}
+
+typedef struct {
+  const char *name;
+  bench_fn fn;
+  bool solver;  // run on the solver grid sizes
+} bench_t;
+
+static const bench_t BENCHES[] = {
+    {"game_won", bench_won, false},
+    {"game_get_status", bench_get_status, false},
+    {"game_nb_neighbors", bench_nb_neighbors, false},
+    {"game_play_move+game_undo", bench_play_undo, false},
+    {"game_undo+game_redo", bench_undo_redo, false},
+    {"game_copy+game_delete", bench_copy, false},
+    {"game_play_move+game_snapshot", bench_snapshot, false},
+    {"game_save+game_load", bench_save_load, false},
+    {"game_check_solutions/64", bench_check_solutions, false},
+    {"game_status_grid", bench_status_grid, false},
+    {"game_solve", bench_solve, true},
+    {"game_nb_solutions", bench_nb_solutions, true},
+};
+
+static const uint SIZES[][2] = {{5, 5}, {16, 16}, {64, 64}, {256, 256}};
+static const uint SOLVER_SIZES[][2] = {{4, 4}, {6, 6}, {8, 8}};
+static const char *NEIGH_NAMES[] = {"FULL", "ORTHO", "FULL_EXCLUDE",
+                                    "ORTHO_EXCLUDE"};
+
+/* ******************** hardware counters ******************** */
+
+typedef struct {
+  int fd[NB_COUNTERS];
+  bool enabled;
+} counters_t;
+
+static const char *COUNTER_NAMES[NB_COUNTERS] = {"cycles", "instructions",
+                                                 "branch_misses",
+                                                 "cache_misses"};
+
+static void counters_open(counters_t *c) {
+  c->enabled = false;
+  for (int n = 0; n < NB_COUNTERS; n++) c->fd[n] = -1;
+#ifdef __linux__
+  static const uint64_t configs[NB_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+  for (int n = 0; n < NB_COUNTERS; n++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[n];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    c->fd[n] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (c->fd[n] < 0) {
+      fprintf(stderr, "perf_event_open unavailable, counters disabled\n");
+      for (int m = 0; m < n; m++) {
+        close(c->fd[m]);
+        c->fd[m] = -1;  // not closed again by counters_close
+      }
+      return;
+    }
+  }
+  c->enabled = true;
+#else
+  fprintf(stderr, "hardware counters are only supported on Linux\n");
+#endif
+}
+
+static void counters_start(counters_t *c) {
+#ifdef __linux__
+  if (!c->enabled) return;
+  for (int n = 0; n < NB_COUNTERS; n++) {
+    ioctl(c->fd[n], PERF_EVENT_IOC_RESET, 0);
+    ioctl(c->fd[n], PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+static void counters_stop(counters_t *c, uint64_t values[NB_COUNTERS]) {
+  for (int n = 0; n < NB_COUNTERS; n++) values[n] = 0;
+#ifdef __linux__
+  if (!c->enabled) return;
+  for (int n = 0; n < NB_COUNTERS; n++) {
+    ioctl(c->fd[n], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(c->fd[n], &values[n], sizeof(uint64_t)) != sizeof(uint64_t)) {
+      values[n] = 0;
+    }
+  }
+#endif
+}
+
+static void counters_close(counters_t *c) {
+  for (int n = 0; n < NB_COUNTERS; n++) {
+    if (c->fd[n] >= 0) close(c->fd[n]);
+  }
+}
+
+/* ******************** measurement ******************** */
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p) {
+  return sorted[(int)(p * (n - 1) + 0.5)];
+}
+
+static void run_bench(const bench_t *b, bench_ctx *ctx, uint nb_rows,
+                      uint nb_cols, bool wrapping, neighbourhood neigh,
+                      counters_t *counters, int max_samples, bool *first) {
+  // calibrate the number of calls per sample
+  uint64_t iters = 1;
+  double elapsed;
+  for (;;) {
+    double start = now_ns();
+    for (uint64_t n = 0; n < iters; n++) b->fn(ctx);
+    elapsed = now_ns() - start;
+    if (elapsed >= SAMPLE_NS || iters >= (1u << 24)) break;
+    iters *= (elapsed > 0 && SAMPLE_NS / elapsed < 16) ? 2 : 16;
+  }
+  int nb_samples = BENCH_NS / elapsed;
+  if (nb_samples > max_samples) nb_samples = max_samples;
+  if (nb_samples < MIN_SAMPLES) nb_samples = MIN_SAMPLES;
+
+  double times[MAX_SAMPLES];
+  double events[NB_COUNTERS][MAX_SAMPLES];
+  for (int s = 0; s < nb_samples; s++) {
+    uint64_t values[NB_COUNTERS];
+    counters_start(counters);
+    double start = now_ns();
+    for (uint64_t n = 0; n < iters; n++) b->fn(ctx);
+    times[s] = (now_ns() - start) / iters;
+    counters_stop(counters, values);
+    for (int c = 0; c < NB_COUNTERS; c++) {
+      events[c][s] = (double)values[c] / iters;
+    }
+  }
+  qsort(times, nb_samples, sizeof(double), cmp_double);
+
+  printf("%s\n    {\"name\": \"%s\", \"rows\": %u, \"cols\": %u, "
+         "\"wrapping\": %s, \"neighbourhood\": \"%s\", \"iterations\": %llu, "
+         "\"samples\": %d,\n     \"ns_per_op\": {\"min\": %.1f, "
+         "\"median\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}",
+         *first ? "" : ",", b->name, nb_rows, nb_cols,
+         wrapping ? "true" : "false", NEIGH_NAMES[neigh],
+         (unsigned long long)iters, nb_samples, times[0],
+         percentile(times, nb_samples, 0.5), percentile(times, nb_samples, 0.9),
+         percentile(times, nb_samples, 0.99), times[nb_samples - 1]);
+  if (counters->enabled) {
+    printf(",\n     \"counters_per_op\": {");
+    for (int c = 0; c < NB_COUNTERS; c++) {
+      qsort(events[c], nb_samples, sizeof(double), cmp_double);
+      printf("%s\"%s\": %.1f", c ? ", " : "", COUNTER_NAMES[c],
+             percentile(events[c], nb_samples, 0.5));
+    }
+    printf("}");
+  }
+  printf("}");
+  fflush(stdout);
+  *first = false;
+}
+
+static void run_config(uint nb_rows, uint nb_cols, bool wrapping,
+                       neighbourhood neigh, bool solver,
+                       const char *filter, counters_t *counters,
+                       int max_samples, char *tmpfile, bool *first) {
+  rng r;
+  rng_seed(&r, 42);
+  game g = NULL;
+  while (g == NULL) {
+    g = game_random_r(nb_rows, nb_cols, wrapping, neigh, true, 0.5f, 0.5f, &r);
+  }
+  bench_ctx ctx = {g,    game_copy(g), nb_rows, nb_cols, 0,
+                   tmpfile, NULL,     NULL,    0};
+  game_restart(ctx.puzzle);
+  size_t size = game_packed_size(g);
+  ctx.packed = malloc(CHECK_BATCH * size);
+  assert(ctx.packed);
+  for (int k = 0; k < CHECK_BATCH; k++) game_pack(g, ctx.packed + k * size);
+  ctx.statuses = malloc((size_t)nb_rows * nb_cols * sizeof(status));
+  assert(ctx.statuses);
+  game_play_move(g, 0, 0, game_get_color(g, 0, 0));  // something to undo
+
+  size_t nb_benches = sizeof(BENCHES) / sizeof(BENCHES[0]);
+  for (size_t b = 0; b < nb_benches; b++) {
+    if (BENCHES[b].solver != solver) continue;
+    if (filter && !strstr(BENCHES[b].name, filter)) continue;
+    run_bench(&BENCHES[b], &ctx, nb_rows, nb_cols, wrapping, neigh, counters,
+              max_samples, first);
+  }
+
+  game_delete(ctx.g);
+  game_delete(ctx.puzzle);
+  free(ctx.packed);
+  free(ctx.statuses);
+}
+
+/* ******************** main ******************** */
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -f <name>     only run benchmarks whose name contains <name>\n"
+          "  -n <samples>  maximum number of samples (default %d)\n"
+          "  -p            read hardware counters with perf_event_open\n"
+          "Results are written as JSON on the standard output.\n",
+          prog, MAX_SAMPLES);
+}
+
+int main(int argc, char *argv[]) {
+  const char *filter = NULL;
+  int max_samples = MAX_SAMPLES;
+  bool perf = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:n:ph")) != -1) {
+    switch (opt) {
+      case 'f':
+        filter = optarg;
+        break;
+      case 'n':
+        max_samples = atoi(optarg);
+        break;
+      case 'p':
+        perf = true;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (max_samples < MIN_SAMPLES || max_samples > MAX_SAMPLES) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  char tmpfile[] = "/tmp/game_bench_XXXXXX";
+  int fd = mkstemp(tmpfile);
+  if (fd < 0) {
+    fprintf(stderr, "cannot create temporary file\n");
+    return EXIT_FAILURE;
+  }
+  close(fd);
+
+  counters_t counters;
+  counters.enabled = false;
+  for (int n = 0; n < NB_COUNTERS; n++) counters.fd[n] = -1;
+  if (perf) counters_open(&counters);
+
+  bool first = true;
+  printf("{\"benchmarks\": [");
+  for (int neigh = FULL; neigh <= ORTHO_EXCLUDE; neigh++) {
+    for (int wrapping = 0; wrapping <= 1; wrapping++) {
+      for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        run_config(SIZES[s][0], SIZES[s][1], wrapping, neigh, false, filter,
+                   &counters, max_samples, tmpfile, &first);
+      }
+      for (size_t s = 0; s < sizeof(SOLVER_SIZES) / sizeof(SOLVER_SIZES[0]); s++) {
+        run_config(SOLVER_SIZES[s][0], SOLVER_SIZES[s][1], wrapping, neigh, true,
+                   filter, &counters, max_samples, tmpfile, &first);
+      }
+    }
+  }
+  printf("\n]}\n");
+
+  counters_close(&counters);
+  remove(tmpfile);
+  return EXIT_SUCCESS;
+}
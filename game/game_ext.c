@@ -10,7 +10,6 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_struct.h"
-#include "queue.h"
 
 /**
  * @brief Creates a new game with extended options and initializes it.
@@ -25,9 +24,13 @@
  * @param neigh neighbourhood option
  * @pre @p constraints must be an initialized array of default size squared
  * @pre @p colors must be an initialized array of default size squared or NULL
- * @return the created game**/
+ * @return the created game, or NULL if @p neigh is not a valid neighbourhood**/
 game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
                   color *colors, bool wrapping, neighbourhood neigh) {
+  if ((uint)neigh > ORTHO_EXCLUDE) {
+    fprintf(stderr, "Invalid neighbourhood: %d\n", (int)neigh);
+    return NULL;
+  }
   game g = malloc(sizeof(struct game_s));
 
   if (g != NULL) {
@@ -38,9 +41,19 @@ game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
       g->neigh = neigh;
       g->history = NULL;  // Initially no history
       g->history_size = 0;
-      g->current_move = -1;           // No moves made yet
-      g->played_moves = queue_new();  // Create the played moves queue
-      g->undone_moves = queue_new();  // Create the undone moves queue
+      g->current_move = 0;  // No moves made yet
+      g->history_capacity = 0;
+      g->snapshots = NULL;
+      g->nb_snapshots = 0;
+      g->first_snapshot = 0;
+      g->snapshot_capacity = 0;
+      g->version = NULL;
+      g->dirty = NULL;
+      g->dirty_list = NULL;
+      g->nb_dirty = 0;
+      g->neighbors = neighbor_table_acquire(g->row, g->column, g->wrapping,
+                                            g->neigh);
+      g->kernels = game_kernels_select(g->neigh);
 
       g->constraints = malloc(g->row * g->column * sizeof(constraint));
       g->colors = malloc(g->row * g->column * sizeof(color));
@@ -62,9 +75,19 @@ game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
     g->neigh = neigh;
     g->history = NULL;  // Initially no history
     g->history_size = 0;
-    g->current_move = -1;           // No moves made yet
-    g->played_moves = queue_new();  // Create the played moves queue
-    g->undone_moves = queue_new();  // Create the undone moves queue
+    g->current_move = 0;  // No moves made yet
+    g->history_capacity = 0;
+    g->snapshots = NULL;
+    g->nb_snapshots = 0;
+    g->first_snapshot = 0;
+    g->snapshot_capacity = 0;
+    g->version = NULL;
+    g->dirty = NULL;
+    g->dirty_list = NULL;
+    g->nb_dirty = 0;
+    g->neighbors = neighbor_table_acquire(g->row, g->column, g->wrapping,
+                                          g->neigh);
+    g->kernels = game_kernels_select(g->neigh);
 
     g->constraints = malloc(g->row * g->column * sizeof(constraint));
     g->colors = malloc(g->row * g->column * sizeof(color));
@@ -92,10 +115,14 @@ game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
  * @param nb_cols number of columns in game
  * @param wrapping wrapping option
  * @param neigh neighbourhood option
- * @return the created game
+ * @return the created game, or NULL if @p neigh is not a valid neighbourhood
  **/
 game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping,
                         neighbourhood neigh) {
+  if ((uint)neigh > ORTHO_EXCLUDE) {
+    fprintf(stderr, "Invalid neighbourhood: %d\n", (int)neigh);
+    return NULL;
+  }
   game g = malloc(sizeof(struct game_s));
   if (g != NULL) {
     g->row = nb_rows;
@@ -104,9 +131,19 @@ game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping,
     g->neigh = neigh;
     g->history = NULL;  // Initially no history
     g->history_size = 0;
-    g->current_move = -1;           // No moves made yet
-    g->played_moves = queue_new();  // Create the played moves queue
-    g->undone_moves = queue_new();  // Create the undone moves queue
+    g->current_move = 0;  // No moves made yet
+    g->history_capacity = 0;
+    g->snapshots = NULL;
+    g->nb_snapshots = 0;
+    g->first_snapshot = 0;
+    g->snapshot_capacity = 0;
+    g->version = NULL;
+    g->dirty = NULL;
+    g->dirty_list = NULL;
+    g->nb_dirty = 0;
+    g->neighbors = neighbor_table_acquire(g->row, g->column, g->wrapping,
+                                          g->neigh);
+    g->kernels = game_kernels_select(g->neigh);
 
     g->constraints = malloc(g->row * g->column * sizeof(constraint));
     g->colors = malloc(g->row * g->column * sizeof(color));
@@ -120,6 +157,7 @@ game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping,
       // Free the allocated memory if one of the allocations failed
       free(g->constraints);
       free(g->colors);
+      neighbor_table_release(g->neighbors);
       free(g);
       return NULL;  // Return NULL to indicate allocation failure
     }
@@ -186,14 +224,12 @@ neighbourhood game_get_neighbourhood(cgame g) {
  * @pre @p g is a valid pointer toward a cgame structure
  **/
 void game_undo(game g) {
-  if (!queue_is_empty(g->played_moves)) {
-    move_t *move = queue_pop_tail(g->played_moves);
+  if (g->current_move > 0) {
+    move_t *move = &g->history[--g->current_move];
 
     // Undo the move in the game
     g->colors[move->i * g->column + move->j] = move->previous_color;
-
-    // Add the move to the start of the undone_moves queue for potential redo
-    queue_push_head(g->undone_moves, move);
+    game_touch(g, move->i * g->column + move->j);
   }
 }
 
@@ -207,13 +243,72 @@ void game_undo(game g) {
  * @pre @p g is a valid pointer toward a cgame structure
  **/
 void game_redo(game g) {
-  if (!queue_is_empty(g->undone_moves)) {
-    move_t *move = queue_pop_head(g->undone_moves);
+  if (g->current_move < g->history_size) {
+    move_t *move = &g->history[g->current_move++];
 
     // Redo the move in the game
     g->colors[move->i * g->column + move->j] = move->applied_color;
+    game_touch(g, move->i * g->column + move->j);
+  }
+}
+
+/**
+ * @brief Gets the number of moves in the history.
+ * @param g the game
+ * @return the number of moves played, including the undone ones that can
+ * still be redone
+ * @pre @p g is a valid pointer toward a cgame structure
+ **/
+size_t game_nb_moves(cgame g) { return g->history_size; }
+
+/**
+ * @brief Gets the position in the history.
+ * @details It is decremented by @ref game_undo and incremented by @ref
+ * game_redo and @ref game_play_move.
+ * @param g the game
+ * @return the number of moves currently applied
+ * @pre @p g is a valid pointer toward a cgame structure
+ **/
+size_t game_current_move(cgame g) { return g->current_move; }
+
+/**
+ * @brief Moves to a given position in the history.
+ * @details Restores the board as it was after the first @p move_index moves of
+ * the history, as a sequence of @ref game_undo or @ref game_redo would, and
+ * without changing the history. Snapshots of the board are kept along the
+ * history, so at most about one move per square is replayed whatever the
+ * distance. If @p move_index is greater than @ref game_nb_moves, this function
+ * does nothing.
+ * @param g the game
+ * @param move_index the number of moves to apply
+ * @pre @p g is a valid pointer toward a cgame structure
+ **/
+void game_goto(game g, size_t move_index) {
+  if (move_index > g->history_size) return;
 
-    // Add the move back to the end of the played_moves queue
-    queue_push_tail(g->played_moves, move);
+  size_t distance = move_index > g->current_move
+                        ? move_index - g->current_move
+                        : g->current_move - move_index;
+  size_t period = snapshot_period(g);
+  size_t slot = move_index / period;
+  if (slot >= g->nb_snapshots) slot = g->nb_snapshots - 1;
+  if (g->nb_snapshots > g->first_snapshot && slot >= g->first_snapshot &&
+      move_index - slot * period < distance) {
+    size_t nb_squares = g->row * g->column;
+    memcpy(g->colors, g->snapshots + slot * nb_squares,
+           nb_squares * sizeof(color));
+    game_touch_all(g);
+    g->current_move = slot * period;
   }
-}
\ No newline at end of file
+
+  while (g->current_move < move_index) {
+    move_t *move = &g->history[g->current_move++];
+    g->colors[move->i * g->column + move->j] = move->applied_color;
+    game_touch(g, move->i * g->column + move->j);
+  }
+  while (g->current_move > move_index) {
+    move_t *move = &g->history[--g->current_move];
+    g->colors[move->i * g->column + move->j] = move->previous_color;
+    game_touch(g, move->i * g->column + move->j);
+  }
+}
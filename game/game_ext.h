@@ -9,6 +9,7 @@
 #define __GAME_EXT_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "game.h"
 
@@ -42,7 +43,7 @@ typedef enum {
  * @param neigh neighbourhood option
  * @pre @p constraints must be an initialized array of default size squared
  * @pre @p colors must be an initialized array of default size squared or NULL
- * @return the created game
+ * @return the created game, or NULL if @p neigh is not a valid neighbourhood
  **/
 game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
                   color *colors, bool wrapping, neighbourhood neigh);
@@ -54,7 +55,7 @@ game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
  * @param nb_cols number of columns in game
  * @param wrapping wrapping option
  * @param neigh neighbourhood option
- * @return the created game
+ * @return the created game, or NULL if @p neigh is not a valid neighbourhood
  **/
 game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping,
                         neighbourhood neigh);
@@ -111,6 +112,39 @@ void game_undo(game g);
  **/
 void game_redo(game g);
 
+/**
+ * @brief Gets the number of moves in the history.
+ * @param g the game
+ * @return the number of moves played, including the undone ones that can
+ * still be redone
+ * @pre @p g is a valid pointer toward a cgame structure
+ **/
+size_t game_nb_moves(cgame g);
+
+/**
+ * @brief Gets the position in the history.
+ * @details It is decremented by @ref game_undo and incremented by @ref
+ * game_redo and @ref game_play_move.
+ * @param g the game
+ * @return the number of moves currently applied
+ * @pre @p g is a valid pointer toward a cgame structure
+ **/
+size_t game_current_move(cgame g);
+
+/**
+ * @brief Moves to a given position in the history.
+ * @details Restores the board as it was after the first @p move_index moves of
+ * the history, as a sequence of @ref game_undo or @ref game_redo would, and
+ * without changing the history. Snapshots of the board are kept along the
+ * history, so at most about one move per square is replayed whatever the
+ * distance. If @p move_index is greater than @ref game_nb_moves, this function
+ * does nothing.
+ * @param g the game
+ * @param move_index the number of moves to apply
+ * @pre @p g is a valid pointer toward a cgame structure
+ **/
+void game_goto(game g, size_t move_index);
+
 /**
  * @}
  */
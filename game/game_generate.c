@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "rng.h"
+#include "trace.h"
+
+#define MAX_BATCH 65536
+#define MAX_STALL 1000000  // candidates without a new puzzle before giving up
+
+typedef struct {
+  uint nb_rows, nb_cols;
+  bool wrapping;
+  neighbourhood neigh;
+  float black_rate, constraint_rate;
+  uint64_t seed;
+} gen_params;
+
+typedef struct {
+  const gen_params *params;
+  uint64_t first;  // index of the first candidate of the batch
+  uint nb;         // number of candidates in the batch
+  uint id, stride;
+  game *slots;     // generated candidates, indexed by (candidate - first)
+  double busy;     // time spent generating, in seconds
+  pthread_t thread;
+} worker_t;
+
+typedef struct {
+  char **keys;
+  size_t capacity, size;
+} puzzle_set;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ******************** generation ******************** */
+
+// Candidate k is drawn from its own stream, so the output only depends on the
+// seed and never on the number of threads or on scheduling.
+static game generate_candidate(const gen_params *p, uint64_t k) {
+  rng r;
+  rng_seed(&r, p->seed ^ (k * 0xD1B54A32D192ED03ULL));
+  return game_random_r(p->nb_rows, p->nb_cols, p->wrapping, p->neigh, false,
+                       p->black_rate, p->constraint_rate, &r);
+}
+
+static void *worker_run(void *arg) {
+  worker_t *w = arg;
+  TRACE_SCOPE("generate_batch");
+  double start = now();
+  for (uint n = w->id; n < w->nb; n += w->stride) {
+    w->slots[n] = generate_candidate(w->params, w->first + n);
+  }
+  w->busy += now() - start;
+  return NULL;
+}
+
+/* ******************** de-duplication ******************** */
+
+static uint64_t key_hash(const char *key) {
+  uint64_t h = 0xCBF29CE484222325ULL;  // FNV-1a
+  for (; *key; key++) h = (h ^ (unsigned char)*key) * 0x100000001B3ULL;
+  return h;
+}
+
+// Returns false if the key was already present (the key is then freed).
+static bool set_insert(puzzle_set *set, char *key) {
+  if (2 * (set->size + 1) > set->capacity) {
+    size_t capacity = set->capacity ? 2 * set->capacity : 1024;
+    char **keys = calloc(capacity, sizeof(char *));
+    if (!keys) {
+      fprintf(stderr, "Allocation mémoire échouée\n");
+      exit(EXIT_FAILURE);
+    }
+    for (size_t n = 0; n < set->capacity; n++) {
+      if (!set->keys[n]) continue;
+      size_t h = key_hash(set->keys[n]) & (capacity - 1);
+      while (keys[h]) h = (h + 1) & (capacity - 1);
+      keys[h] = set->keys[n];
+    }
+    free(set->keys);
+    set->keys = keys;
+    set->capacity = capacity;
+  }
+  size_t h = key_hash(key) & (set->capacity - 1);
+  while (set->keys[h]) {
+    if (strcmp(set->keys[h], key) == 0) {
+      free(key);
+      return false;
+    }
+    h = (h + 1) & (set->capacity - 1);
+  }
+  set->keys[h] = key;
+  set->size++;
+  return true;
+}
+
+static void set_free(puzzle_set *set) {
+  for (size_t n = 0; n < set->capacity; n++) free(set->keys[n]);
+  free(set->keys);
+}
+
+// Puzzles are identical when they have the same constraints.
+static char *puzzle_key(cgame g) {
+  uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+  char *key = malloc(nb_rows * nb_cols + 1);
+  for (uint i = 0; i < nb_rows; i++) {
+    for (uint j = 0; j < nb_cols; j++) {
+      constraint n = game_get_constraint(g, i, j);
+      key[i * nb_cols + j] = (n == UNCONSTRAINED) ? '-' : '0' + n;
+    }
+  }
+  key[nb_rows * nb_cols] = '\0';
+  return key;
+}
+
+/* ******************** main ******************** */
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -r <rows>     number of rows (default 5)\n"
+          "  -c <cols>     number of columns (default 5)\n"
+          "  -w            wrapping grid\n"
+          "  -n <neigh>    neighbourhood: 0=FULL 1=ORTHO 2=FULL_EXCLUDE "
+          "3=ORTHO_EXCLUDE\n"
+          "  -k <count>    number of distinct puzzles (default 100)\n"
+          "  -s <seed>     random seed (default 0)\n"
+          "  -t <threads>  number of worker threads (default: all cores)\n"
+          "  -b <rate>     black rate (default 0.5)\n"
+          "  -p <rate>     constraint rate (default 0.5)\n"
+          "  -o <output>   output directory or file (default stdout)\n"
+          "  --trace <file> write a Chrome trace of the generation\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  gen_params params = {5, 5, false, FULL, 0.5f, 0.5f, 0};
+  uint count = 100;
+  long nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  uint nb_threads = nb_cores > 0 ? nb_cores : 1;
+  char *output = NULL;
+  trace_parse_args(&argc, argv);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:c:wn:k:s:t:b:p:o:h")) != -1) {
+    switch (opt) {
+      case 'r':
+        params.nb_rows = atoi(optarg);
+        break;
+      case 'c':
+        params.nb_cols = atoi(optarg);
+        break;
+      case 'w':
+        params.wrapping = true;
+        break;
+      case 'n':
+        params.neigh = (neighbourhood)atoi(optarg);
+        break;
+      case 'k':
+        count = atoi(optarg);
+        break;
+      case 's':
+        params.seed = strtoull(optarg, NULL, 10);
+        break;
+      case 't':
+        nb_threads = atoi(optarg);
+        break;
+      case 'b':
+        params.black_rate = atof(optarg);
+        break;
+      case 'p':
+        params.constraint_rate = atof(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (params.nb_rows == 0 || params.nb_cols == 0 ||
+      params.neigh > ORTHO_EXCLUDE || nb_threads == 0 ||
+      params.black_rate < 0.0f || params.black_rate > 1.0f ||
+      params.constraint_rate < 0.0f || params.constraint_rate > 1.0f) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // a directory receives one file per puzzle, anything else a single stream
+  struct stat st;
+  bool to_dir = output && stat(output, &st) == 0 && S_ISDIR(st.st_mode);
+  FILE *out = stdout;
+  if (output && !to_dir) {
+    out = fopen(output, "w");
+    if (!out) {
+      fprintf(stderr, "error opening output file %s: %s\n", output,
+              strerror(errno));
+      return EXIT_FAILURE;
+    }
+  }
+
+  worker_t *workers = calloc(nb_threads, sizeof(worker_t));
+  game *slots = malloc(MAX_BATCH * sizeof(game));
+  if (!workers || !slots) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    return EXIT_FAILURE;
+  }
+
+  puzzle_set set = {NULL, 0, 0};
+  uint64_t next = 0, last_new = 0;
+  uint kept = 0, duplicates = 0, invalid = 0;
+  double start = now();
+
+  while (kept < count) {
+    uint nb = count - kept + nb_threads;
+    if (nb > MAX_BATCH) nb = MAX_BATCH;
+
+    for (uint t = 0; t < nb_threads; t++) {
+      workers[t].params = &params;
+      workers[t].first = next;
+      workers[t].nb = nb;
+      workers[t].id = t;
+      workers[t].stride = nb_threads;
+      workers[t].slots = slots;
+      pthread_create(&workers[t].thread, NULL, worker_run, &workers[t]);
+    }
+    for (uint t = 0; t < nb_threads; t++) pthread_join(workers[t].thread, NULL);
+
+    // candidates are kept in index order, which makes the output reproducible
+    for (uint n = 0; n < nb; n++) {
+      game g = slots[n];
+      if (!g) {
+        invalid++;
+      } else if (kept == count || !set_insert(&set, puzzle_key(g))) {
+        if (kept < count) duplicates++;
+      } else if (to_dir) {
+        char filename[4096];
+        snprintf(filename, sizeof(filename), "%s/puzzle_%06u.txt", output,
+                 kept);
+        game_save(g, filename);
+        kept++;
+        last_new = next + n;
+      } else {
+        game_save_file(g, out);
+        kept++;
+        last_new = next + n;
+      }
+      game_delete(g);
+    }
+    next += nb;
+
+    if (kept < count && next - last_new > MAX_STALL) {
+      fprintf(stderr, "only %u distinct puzzles found, giving up\n", kept);
+      break;
+    }
+  }
+
+  double elapsed = now() - start;
+  if (out != stdout) fclose(out);
+
+  fprintf(stderr, "puzzles:    %u (%ux%u%s, neighbourhood %d, seed %llu)\n",
+          kept, params.nb_rows, params.nb_cols,
+          params.wrapping ? " wrapping" : "", params.neigh,
+          (unsigned long long)params.seed);
+  fprintf(stderr, "candidates: %llu (%u duplicates, %u invalid)\n",
+          (unsigned long long)next, duplicates, invalid);
+  fprintf(stderr, "threads:    %u\n", nb_threads);
+  fprintf(stderr, "elapsed:    %.3f s (%.0f puzzles/s)\n", elapsed,
+          elapsed > 0 ? kept / elapsed : 0.0);
+  for (uint t = 0; t < nb_threads; t++) {
+    fprintf(stderr, "  worker %u: %.3f s busy\n", t, workers[t].busy);
+  }
+
+  set_free(&set);
+  free(slots);
+  free(workers);
+  return EXIT_SUCCESS;
+}
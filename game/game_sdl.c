@@ -6,6 +6,7 @@
 #include <SDL_image.h>  // required to load transparent texture from PNG
 #include <SDL_ttf.h>    // required to use TTF fonts
 #include <stdbool.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -15,11 +16,19 @@
 #include "game_ext.h"
 #include "game_struct.h"
 #include "game_tools.h"
-#include "queue.h"
+#include "trace.h"
 
 /* **************************************************************** */
 
-#define MIN_CELL_SIZE 30  // Minimum size for each cell in the grid
+#define DEFAULT_CELL_SIZE 30  // Size of each cell in the grid, before zooming
+#define MAX_CELL_SIZE 120     // Largest zoom, in pixels per cell
+#define LOD_CELL_SIZE 8       // Below this size, cells come from a bitmap
+#define DIGIT_CELL_SIZE 16    // Below this size, constraints are not drawn
+#define BOARD_MAX_SIZE 4096   // Largest board texture, in pixels
+#define LOD_MAX_SIZE 2048     // Largest level-of-detail bitmap, in pixels
+#define ZOOM_STEP 1.25        // Zoom factor of a wheel notch or a key press
+#define PAN_STEP 0.1          // Fraction of the window panned by arrow keys
+#define GRID_MARGIN 80        // Room kept for the buttons when fitting
 #define FONT_PATH "res/arial.ttf"
 #define FONT_SIZE 14
 #define STATE_NONE 0
@@ -27,6 +36,60 @@
 #define STATE_WHITE 2
 
 #define NUM_BUTTONS 5
+#define NB_STATUS 3       // ERROR, UNSATISFIED, SATISFIED
+#define NB_DIGITS 10      // constraints range from 0 to 9
+#define ATLAS_WIDTH 1024  // the atlas wraps to a new line past this width
+#define WON_TEXT "Game Won"
+#define NO_SOLUTION_TEXT "Pas de solution"
+
+#define RANDOM_SIZE 4         // rows and columns of the "Jeu Aléatoire" games
+#define POOL_SIZE 16          // puzzles kept ready for "Jeu Aléatoire"
+#define POOL_LOW 8            // the pool is refilled below this size
+#define TASK_INTERVAL 1024    // solver nodes between two cancellation checks
+#define PROGRESS_PERIOD 33    // ms between two progress redraws (~30 fps)
+#define PROGRESS_WIDTH 200    // width of the progress bar
+
+typedef enum { TASK_NONE, TASK_SOLVE, TASK_RANDOM, NB_TASKS } task_kind;
+
+// Long computations run on a worker thread so that the window stays
+// responsive. The worker owns the game of the task until it posts its "done"
+// event; the UI thread then swaps the result in.
+typedef struct {
+  task_kind kind;          // TASK_NONE when idle
+  int id;                  // tags the events of the current task
+  SDL_Thread *thread;
+  SDL_atomic_t cancel;     // raised by the UI thread to stop the worker
+  SDL_atomic_t permille;   // progress of the solver, in thousandths
+  Uint32 lastReport;       // time of the last progress event (worker side)
+  Uint32 eventType;        // progress events, eventType + 1 for "done"
+  game game;               // game to solve, then the result (NULL if none)
+  rng *random_state;
+} Task;
+
+// Configuration of the random games
+typedef struct {
+  uint nb_rows, nb_cols;
+  bool wrapping;
+  neighbourhood neigh;
+} RandomConfig;
+
+static const RandomConfig RANDOM_CONFIG = {RANDOM_SIZE, RANDOM_SIZE, false,
+                                           FULL};
+
+// Solvable puzzles generated ahead of time by a producer thread, so that
+// "Jeu Aléatoire" only has to pop one. The producer sleeps until the pool
+// falls below POOL_LOW, then fills it up to POOL_SIZE.
+typedef struct {
+  RandomConfig config;
+  game games[POOL_SIZE];
+  int size;
+  SDL_mutex *lock;  // protects games and size
+  SDL_cond *low;    // signaled when the pool runs low or must stop
+  SDL_atomic_t quit;
+  SDL_Thread *thread;
+  rng random_state;   // own stream, the producer never touches Env
+  const char *file;   // where the pool is saved at exit, or NULL
+} Pool;
 
 typedef struct {
   SDL_Rect rect;  // x, y, w, h
@@ -37,25 +100,694 @@ typedef struct {
 struct Env_t {
   TTF_Font *font;
   SDL_Color textColor;
-  int cellSize;       // Size of each grid cell
+  int cellSize;       // Size of each grid cell (zoom rounded down)
   bool cellSelected;  // Indicates if a cell is selected
   int selectedRow;    // Row of the selected cell
   int selectedCol;    // Column of the selected cell
 
   game game_instance;
   Button buttons[NUM_BUTTONS];
+  rng random_state;  // Generator for "Jeu Aléatoire", seeded once in init
+  Task task;         // background solver or generator, see start_task
+  Pool pool;         // ready-made random games, see pool_pop
+
+  // Every text is rasterised once into the atlas, see build_atlas
+  int fontSize;
+  SDL_Texture *atlas;
+  SDL_Rect digitRects[NB_STATUS][NB_DIGITS];  // indexed by status, digit
+  SDL_Rect labelRects[NUM_BUTTONS];
+  SDL_Rect wonRect;
+  SDL_Rect taskRects[NB_TASKS];  // "in progress" message of each task
+  SDL_Rect noSolutionRect;
+
+  bool noSolution;  // the last solve failed, shown until the next click
+
+  bool dirty;  // the window must be redrawn, see needs_render
+
+  // The grid is kept in a texture where only the changed squares are repainted
+  SDL_Texture *board;
+  bool boardInvalid;  // every square must be repainted
+  bool *dirtyCells;   // squares to repaint, also listed in dirtyList
+  uint *dirtyList;
+  uint nbDirty;
+
+  // Status of every cell, kept up to date by refresh_status and
+  // invalidate_cell, and the number of cells still empty or not satisfied
+  status *statusCache;
+  bool *pendingCells;
+  uint nbPending;
+
+  // View: zoom in pixels per cell, and the board point (in cells) shown at
+  // the center of the window
+  double zoom;
+  double centerX, centerY;
+  bool viewReset;  // fit the board in the window at the next frame
+
+  // Level-of-detail bitmap for small zooms, one texel per lodFactor^2 cells
+  SDL_Texture *lod;
+  Uint32 *lodPixels;
+  int lodFactor, lodWidth, lodHeight;
+  bool lodInvalid;
 };
 
-void afficherTexte(SDL_Renderer *renderer, int x, int y, const char *texte,
-                   TTF_Font *police, SDL_Color couleur) {
+/* **************************************************************** */
+
+// Messages shown while a task runs, indexed by task_kind
+static const char *TASK_TEXTS[NB_TASKS] = {NULL, "Résolution...",
+                                           "Génération..."};
+
+// Color of the constraints, indexed by status
+static const SDL_Color STATUS_COLORS[NB_STATUS] = {
+    {255, 0, 0, 255},    // ERROR
+    {0, 128, 128, 255},  // UNSATISFIED
+    {0, 128, 128, 255},  // SATISFIED
+};
+
+// Renders the digits in every status color, the button labels and the
+// victory message, and packs them into a single texture. Frames then only
+// copy rectangles out of it: no font rasterisation nor texture creation.
+static void build_atlas(SDL_Renderer *ren, Env *env) {
+  enum { NB_TEXTS = NB_STATUS * NB_DIGITS + NUM_BUTTONS + NB_TASKS + 1 };
+  SDL_Surface *surfaces[NB_TEXTS];
+  SDL_Rect *rects[NB_TEXTS];
+  int nb = 0;
+  for (int s = 0; s < NB_STATUS; s++) {
+    for (int d = 0; d < NB_DIGITS; d++) {
+      char digit[2] = {'0' + d, '\0'};
+      surfaces[nb] = TTF_RenderUTF8_Solid(env->font, digit, STATUS_COLORS[s]);
+      rects[nb++] = &env->digitRects[s][d];
+    }
+  }
+  for (int i = 0; i < NUM_BUTTONS; i++) {
+    surfaces[nb] = TTF_RenderUTF8_Solid(env->font, env->buttons[i].text,
+                                        (SDL_Color){255, 255, 255, 255});
+    rects[nb++] = &env->labelRects[i];
+  }
+  surfaces[nb] = TTF_RenderUTF8_Solid(env->font, WON_TEXT, env->textColor);
+  rects[nb++] = &env->wonRect;
+  for (int k = TASK_SOLVE; k < NB_TASKS; k++) {
+    surfaces[nb] = TTF_RenderUTF8_Solid(env->font, TASK_TEXTS[k],
+                                        (SDL_Color){0, 0, 0, 255});
+    rects[nb++] = &env->taskRects[k];
+  }
+  surfaces[nb] = TTF_RenderUTF8_Solid(env->font, NO_SOLUTION_TEXT,
+                                      (SDL_Color){255, 0, 0, 255});
+  rects[nb++] = &env->noSolutionRect;
+
+  // shelf packing, left to right then top to bottom
+  int x = 0, y = 0, shelfHeight = 0, width = 1;
+  for (int n = 0; n < nb; n++) {
+    if (!surfaces[n]) ERROR("Error: TTF_RenderUTF8_Solid (%s)", TTF_GetError());
+    if (x > 0 && x + surfaces[n]->w > ATLAS_WIDTH) {
+      x = 0;
+      y += shelfHeight + 1;
+      shelfHeight = 0;
+    }
+    *rects[n] = (SDL_Rect){x, y, surfaces[n]->w, surfaces[n]->h};
+    x += surfaces[n]->w + 1;
+    if (x > width) width = x;
+    if (surfaces[n]->h > shelfHeight) shelfHeight = surfaces[n]->h;
+  }
+
+  SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(
+      0, width, y + shelfHeight, 32, SDL_PIXELFORMAT_RGBA8888);
+  if (!sheet) ERROR("Error: SDL_CreateRGBSurface (%s)", SDL_GetError());
+  for (int n = 0; n < nb; n++) {
+    SDL_Rect dst = *rects[n];  // SDL_BlitSurface may clip it
+    SDL_BlitSurface(surfaces[n], NULL, sheet, &dst);
+    SDL_FreeSurface(surfaces[n]);
+  }
+  if (env->atlas) SDL_DestroyTexture(env->atlas);
+  env->atlas = SDL_CreateTextureFromSurface(ren, sheet);
+  SDL_FreeSurface(sheet);
+  if (!env->atlas) ERROR("Error: SDL_CreateTexture (%s)", SDL_GetError());
+  SDL_SetTextureBlendMode(env->atlas, SDL_BLENDMODE_BLEND);
+}
+
+// (Re)opens the font at the given size and rebuilds the atlas accordingly.
+static void set_font_size(SDL_Renderer *ren, Env *env, int fontSize) {
+  if (env->font && fontSize == env->fontSize) return;
+  if (env->font) TTF_CloseFont(env->font);
+  env->font = TTF_OpenFont(FONT_PATH, fontSize);
+  if (!env->font) ERROR("Error: TTF_OpenFont (%s)", TTF_GetError());
+  env->fontSize = fontSize;
+  build_atlas(ren, env);
+}
+
+// Copies a text of the atlas at the given position.
+static void draw_text(SDL_Renderer *ren, Env *env, const SDL_Rect *text, int x,
+                      int y) {
+  SDL_Rect dst = {x, y, text->w, text->h};
+  SDL_RenderCopy(ren, env->atlas, text, &dst);
+}
+
+/* **************************************************************** */
+
+// Draws a square (color, border and constraint), the grid starting at (x0, y0)
+static void draw_cell(SDL_Renderer *ren, Env *env, int row, int col, int x0,
+                      int y0) {
+  int x = x0 + col * env->cellSize;
+  int y = y0 + row * env->cellSize;
+  SDL_Rect cellRect = {x, y, env->cellSize, env->cellSize};
+  switch (game_get_color(env->game_instance, row, col)) {
+    case BLACK:
+      SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+      break;
+    case WHITE:
+      SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+      break;
+    default:
+      SDL_SetRenderDrawColor(ren, 188, 188, 188, 255);  // background grey
+      break;
+  }
+  SDL_RenderFillRect(ren, &cellRect);
+
+  // borders are shared with the next squares, hence the extra pixel
+  SDL_Rect borderRect = {x, y, env->cellSize + 1, env->cellSize + 1};
+  SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+  SDL_RenderDrawRect(ren, &borderRect);
+
+  int constraint = game_get_constraint(env->game_instance, row, col);
+  if (constraint != UNCONSTRAINED && env->cellSize >= DIGIT_CELL_SIZE) {
+    status s = env->statusCache[row * game_nb_cols(env->game_instance) + col];
+    draw_text(ren, env, &env->digitRects[s][constraint], x + 5, y + 5);
+  }
+}
+
+// Recomputes the cached status of a cell. Returns true if it changed.
+static bool update_status(Env *env, int row, int col) {
+  cgame g = env->game_instance;
+  uint k = row * game_nb_cols(g) + col;
+  status s = game_get_status(g, row, col);
+  bool pending = s != SATISFIED || game_get_color(g, row, col) == EMPTY;
+  bool changed = s != env->statusCache[k];
+  env->nbPending += (int)pending - (int)env->pendingCells[k];
+  env->statusCache[k] = s;
+  env->pendingCells[k] = pending;
+  return changed;
+}
+
+// Recomputes every cached status, after the whole board changed.
+static void refresh_status(Env *env) {
+  cgame g = env->game_instance;
+  for (uint row = 0; row < game_nb_rows(g); row++) {
+    for (uint col = 0; col < game_nb_cols(g); col++) {
+      update_status(env, row, col);
+    }
+  }
+}
+
+// The game is won once every cell is colored and satisfied.
+static bool is_won(const Env *env) { return env->nbPending == 0; }
+
+// To be called whenever env->game_instance is replaced.
+static void reset_board(Env *env) {
+  uint nb_squares =
+      game_nb_rows(env->game_instance) * game_nb_cols(env->game_instance);
+  free(env->dirtyCells);
+  free(env->dirtyList);
+  free(env->statusCache);
+  free(env->pendingCells);
+  env->dirtyCells = calloc(nb_squares, sizeof(bool));
+  env->dirtyList = malloc(nb_squares * sizeof(uint));
+  env->statusCache = calloc(nb_squares, sizeof(status));
+  env->pendingCells = calloc(nb_squares, sizeof(bool));
+  if (!env->dirtyCells || !env->dirtyList || !env->statusCache ||
+      !env->pendingCells) {
+    ERROR("Error: out of memory\n");
+  }
+  env->nbPending = 0;
+  refresh_status(env);
+  env->nbDirty = 0;
+  env->boardInvalid = true;
+  env->lodInvalid = true;
+  env->viewReset = true;
+  env->dirty = true;
+}
+
+static void invalidate_board(Env *env) {
+  env->boardInvalid = true;
+  env->lodInvalid = true;
+  env->dirty = true;
+}
+
+static void clear_dirty_cells(Env *env) {
+  for (uint n = 0; n < env->nbDirty; n++) {
+    env->dirtyCells[env->dirtyList[n]] = false;
+  }
+  env->nbDirty = 0;
+}
+
+// A move on a square changes its color and the status of the cells around
+// it, all within the 3x3 block centered on the square: their cached status is
+// refreshed and they are marked for repaint. To be called after the move.
+static void invalidate_cell(Env *env, int row, int col) {
+  cgame g = env->game_instance;
+  int nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+  for (int i = row - 1; i <= row + 1; i++) {
+    for (int j = col - 1; j <= col + 1; j++) {
+      int r = i, c = j;
+      if (game_is_wrapping(g)) {
+        r = (r + nb_rows) % nb_rows;
+        c = (c + nb_cols) % nb_cols;
+      } else if (r < 0 || r >= nb_rows || c < 0 || c >= nb_cols) {
+        continue;
+      }
+      uint k = r * nb_cols + c;
+      update_status(env, r, c);
+      if (!env->dirtyCells[k]) {
+        env->dirtyCells[k] = true;
+        env->dirtyList[env->nbDirty++] = k;
+      }
+    }
+  }
+  env->dirty = true;
+}
+
+// Brings the board texture up to date, repainting only the changed squares
+// unless the board was invalidated. Returns false if the renderer does not
+// support render targets.
+static bool update_board(SDL_Renderer *ren, Env *env) {
+  int nb_rows = game_nb_rows(env->game_instance);
+  int nb_cols = game_nb_cols(env->game_instance);
+  int width = nb_cols * env->cellSize + 1;
+  int height = nb_rows * env->cellSize + 1;
+
+  int boardWidth = 0, boardHeight = 0;
+  if (env->board) {
+    SDL_QueryTexture(env->board, NULL, NULL, &boardWidth, &boardHeight);
+  }
+  if (!env->board || boardWidth != width || boardHeight != height) {
+    if (env->board) SDL_DestroyTexture(env->board);
+    env->board = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888,
+                                   SDL_TEXTUREACCESS_TARGET, width, height);
+    env->boardInvalid = true;
+  }
+  if (!env->board || SDL_SetRenderTarget(ren, env->board) != 0) return false;
+
+  // the bitmap is not repainted meanwhile
+  if (env->nbDirty > 0) env->lodInvalid = true;
+  if (env->boardInvalid) {
+    for (int row = 0; row < nb_rows; row++) {
+      for (int col = 0; col < nb_cols; col++) {
+        draw_cell(ren, env, row, col, 0, 0);
+      }
+    }
+  } else {
+    for (uint n = 0; n < env->nbDirty; n++) {
+      uint k = env->dirtyList[n];
+      draw_cell(ren, env, k / nb_cols, k % nb_cols, 0, 0);
+    }
+  }
+  clear_dirty_cells(env);
+  env->boardInvalid = false;
+  SDL_SetRenderTarget(ren, NULL);
+  return true;
+}
+
+/* **************************************************************** */
+
+// Averages the colors of a block of lodFactor x lodFactor cells into a texel.
+static void update_texel(Env *env, int bx, int by) {
+  cgame g = env->game_instance;
+  int f = env->lodFactor;
+  int row1 = (by + 1) * f, col1 = (bx + 1) * f;
+  if (row1 > (int)game_nb_rows(g)) row1 = game_nb_rows(g);
+  if (col1 > (int)game_nb_cols(g)) col1 = game_nb_cols(g);
+  int sum = 0, nb = 0;
+  for (int row = by * f; row < row1; row++) {
+    for (int col = bx * f; col < col1; col++) {
+      color c = game_get_color(g, row, col);
+      sum += (c == BLACK) ? 0 : (c == WHITE) ? 255 : 188;
+      nb++;
+    }
+  }
+  Uint32 v = sum / nb;
+  env->lodPixels[by * env->lodWidth + bx] = (v << 24) | (v << 16) | (v << 8) |
+                                            0xFF;
+}
+
+// Brings the level-of-detail bitmap up to date, uploading only the texels of
+// the changed cells unless it was invalidated. Returns false on error.
+static bool update_lod(SDL_Renderer *ren, Env *env) {
+  int nb_rows = game_nb_rows(env->game_instance);
+  int nb_cols = game_nb_cols(env->game_instance);
+  int size = (nb_rows > nb_cols) ? nb_rows : nb_cols;
+  int f = (size + LOD_MAX_SIZE - 1) / LOD_MAX_SIZE;
+  int width = (nb_cols + f - 1) / f, height = (nb_rows + f - 1) / f;
+  if (!env->lod || width != env->lodWidth || height != env->lodHeight) {
+    if (env->lod) SDL_DestroyTexture(env->lod);
+    free(env->lodPixels);
+    env->lod = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888,
+                                 SDL_TEXTUREACCESS_STATIC, width, height);
+    env->lodPixels = malloc(width * height * sizeof(Uint32));
+    env->lodFactor = f;
+    env->lodWidth = width;
+    env->lodHeight = height;
+    env->lodInvalid = true;
+  }
+  if (!env->lod || !env->lodPixels) return false;
+
+  // the board texture is not repainted meanwhile
+  if (env->nbDirty > 0) env->boardInvalid = true;
+  if (env->lodInvalid) {
+    for (int by = 0; by < height; by++) {
+      for (int bx = 0; bx < width; bx++) update_texel(env, bx, by);
+    }
+    SDL_UpdateTexture(env->lod, NULL, env->lodPixels, width * sizeof(Uint32));
+  } else if (env->nbDirty > 0) {
+    int bx0 = width, by0 = height, bx1 = -1, by1 = -1;
+    for (uint n = 0; n < env->nbDirty; n++) {
+      int bx = env->dirtyList[n] % nb_cols / f;
+      int by = env->dirtyList[n] / nb_cols / f;
+      update_texel(env, bx, by);
+      if (bx < bx0) bx0 = bx;
+      if (bx > bx1) bx1 = bx;
+      if (by < by0) by0 = by;
+      if (by > by1) by1 = by;
+    }
+    SDL_Rect rect = {bx0, by0, bx1 - bx0 + 1, by1 - by0 + 1};
+    SDL_UpdateTexture(env->lod, &rect, env->lodPixels + by0 * width + bx0,
+                      width * sizeof(Uint32));
+  }
+  clear_dirty_cells(env);
+  env->lodInvalid = false;
+  return true;
+}
+
+/* **************************************************************** */
+
+// Keeps the center of the view on the board.
+static void clamp_view(Env *env) {
+  double nb_rows = game_nb_rows(env->game_instance);
+  double nb_cols = game_nb_cols(env->game_instance);
+  env->centerX = fmax(0.0, fmin(nb_cols, env->centerX));
+  env->centerY = fmax(0.0, fmin(nb_rows, env->centerY));
+}
+
+// Largest zoom showing the whole board, capped to the default cell size.
+static double fit_zoom(Env *env, int winWidth, int winHeight) {
+  double fitX = (double)winWidth / game_nb_cols(env->game_instance);
+  double fitY =
+      (double)(winHeight - 2 * GRID_MARGIN) / game_nb_rows(env->game_instance);
+  double zoom = fmin(DEFAULT_CELL_SIZE, fmin(fitX, fitY));
+  return (zoom >= LOD_CELL_SIZE) ? floor(zoom) : fmax(zoom, 1e-3);
+}
+
+static void fit_view(Env *env, int winWidth, int winHeight) {
+  env->zoom = fit_zoom(env, winWidth, winHeight);
+  env->centerX = game_nb_cols(env->game_instance) / 2.0;
+  env->centerY = game_nb_rows(env->game_instance) / 2.0;
+  env->viewReset = false;
+}
+
+// Zooms by the given factor, keeping the board point under (x, y) in place.
+// Cells are drawn with a whole number of pixels above LOD_CELL_SIZE.
+static void zoom_at(Env *env, int winWidth, int winHeight, double factor,
+                    int x, int y) {
+  double boardX = env->centerX + (x - winWidth / 2.0) / env->zoom;
+  double boardY = env->centerY + (y - winHeight / 2.0) / env->zoom;
+  double minZoom = fit_zoom(env, winWidth, winHeight) / 2;
+  double zoom = fmax(minZoom, fmin(MAX_CELL_SIZE, env->zoom * factor));
+  if (zoom >= LOD_CELL_SIZE) zoom = (factor > 1) ? ceil(zoom) : floor(zoom);
+  env->centerX = boardX - (x - winWidth / 2.0) / zoom;
+  env->centerY = boardY - (y - winHeight / 2.0) / zoom;
+  env->zoom = zoom;
+  clamp_view(env);
+  env->dirty = true;
+}
+
+static void pan(Env *env, double dx, double dy) {
+  env->centerX += dx / env->zoom;
+  env->centerY += dy / env->zoom;
+  clamp_view(env);
+  env->dirty = true;
+}
+
+// Screen position of the top-left corner of the board.
+static void board_origin(const Env *env, int winWidth, int winHeight, int *x0,
+                         int *y0) {
+  *x0 = (int)floor(winWidth / 2.0 - env->centerX * env->zoom);
+  *y0 = (int)floor(winHeight / 2.0 - env->centerY * env->zoom);
+}
+
+// Draws the part of the board inside the window: from the board texture when
+// it fits, cell by cell over the visible range otherwise, or from the
+// level-of-detail bitmap at small zooms.
+static void draw_board(SDL_Renderer *ren, Env *env, int winWidth,
+                       int winHeight) {
+  int nb_rows = game_nb_rows(env->game_instance);
+  int nb_cols = game_nb_cols(env->game_instance);
+  int x0, y0;
+  board_origin(env, winWidth, winHeight, &x0, &y0);
+
+  if (env->zoom < LOD_CELL_SIZE) {
+    if (update_lod(ren, env)) {
+      SDL_Rect dst = {x0, y0, (int)ceil(nb_cols * env->zoom),
+                      (int)ceil(nb_rows * env->zoom)};
+      SDL_RenderCopy(ren, env->lod, NULL, &dst);
+    }
+    return;
+  }
+
+  env->cellSize = (int)env->zoom;
+  int width = nb_cols * env->cellSize, height = nb_rows * env->cellSize;
+  if (width < BOARD_MAX_SIZE && height < BOARD_MAX_SIZE &&
+      update_board(ren, env)) {
+    SDL_Rect dst = {x0, y0, width + 1, height + 1};
+    SDL_RenderCopy(ren, env->board, NULL, &dst);
+    return;
+  }
+
+  // too large for a texture (or no render target support): visible cells only
+  int col0 = (x0 < 0) ? -x0 / env->cellSize : 0;
+  int row0 = (y0 < 0) ? -y0 / env->cellSize : 0;
+  int col1 = (winWidth - x0) / env->cellSize + 1;
+  int row1 = (winHeight - y0) / env->cellSize + 1;
+  if (col1 > nb_cols) col1 = nb_cols;
+  if (row1 > nb_rows) row1 = nb_rows;
+  for (int row = row0; row < row1; row++) {
+    for (int col = col0; col < col1; col++) {
+      draw_cell(ren, env, row, col, x0, y0);
+    }
+  }
+  if (env->nbDirty > 0) {
+    env->boardInvalid = true;
+    env->lodInvalid = true;
+  }
+  clear_dirty_cells(env);
+}
+
+/* **************************************************************** */
+
+static void push_task_event(Task *task, int offset) {
+  SDL_Event event;
+  memset(&event, 0, sizeof(event));
+  event.type = task->eventType + offset;
+  event.user.code = task->id;
+  SDL_PushEvent(&event);
+}
+
+// Progress callback of the solver, on the worker thread.
+static bool task_progress(const game_solver_stats *stats, void *data) {
+  Task *task = data;
+  SDL_AtomicSet(&task->permille, (int)(1000 * stats->progress));
+  Uint32 now = SDL_GetTicks();
+  if (now - task->lastReport >= PROGRESS_PERIOD) {
+    task->lastReport = now;
+    push_task_event(task, 0);
+  }
+  return SDL_AtomicGet(&task->cancel) == 0;
+}
 
-  SDL_Surface *surface = TTF_RenderText_Solid(police, texte, couleur);
-  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-  SDL_Rect destRect = {x, y, surface->w, surface->h};
-  SDL_RenderCopy(renderer, texture, NULL, &destRect);
-  SDL_FreeSurface(surface);
-  SDL_DestroyTexture(texture);
+// Draws games until one has a solution. Returns NULL once *cancel is raised;
+// progress (with data) is the callback of the solution counter.
+static game generate_puzzle(const RandomConfig *config, rng *random_state,
+                            SDL_atomic_t *cancel, game_solver_progress progress,
+                            void *data) {
+  game g = NULL;
+  while (!g && SDL_AtomicGet(cancel) == 0) {
+    g = game_random_r(config->nb_rows, config->nb_cols, config->wrapping,
+                      config->neigh, false, 0.6f, 0.5f, random_state);
+    if (g && game_nb_solutions_ext(g, NULL, progress, data, TASK_INTERVAL) ==
+                 0) {
+      game_delete(g);
+      g = NULL;
+    }
+  }
+  return g;
+}
+
+static int task_run(void *data) {
+  Task *task = data;
+  if (task->kind == TASK_SOLVE) {
+    if (!game_solve_ext(task->game, NULL, task_progress, task,
+                        TASK_INTERVAL)) {
+      game_delete(task->game);
+      task->game = NULL;
+    }
+  } else {
+    task->game = generate_puzzle(&RANDOM_CONFIG, task->random_state,
+                                 &task->cancel, task_progress, task);
+  }
+  push_task_event(task, 1);
+  return 0;
+}
+
+// Stops the running task, if any, and drops its result.
+static void cancel_task(Env *env) {
+  Task *task = &env->task;
+  if (task->kind == TASK_NONE) return;
+  SDL_AtomicSet(&task->cancel, 1);
+  if (task->thread) SDL_WaitThread(task->thread, NULL);
+  if (task->game) game_delete(task->game);
+  task->game = NULL;
+  task->kind = TASK_NONE;
+  env->dirty = true;
+}
+
+static void start_task(Env *env, task_kind kind) {
+  Task *task = &env->task;
+  cancel_task(env);
+  task->kind = kind;
+  task->id++;
+  SDL_AtomicSet(&task->cancel, 0);
+  SDL_AtomicSet(&task->permille, 0);
+  task->lastReport = SDL_GetTicks();
+  env->noSolution = false;
+  task->game = (kind == TASK_SOLVE) ? game_copy(env->game_instance) : NULL;
+  task->random_state = &env->random_state;
+  task->thread = SDL_CreateThread(task_run, "task", task);
+  if (!task->thread) task_run(task);  // no thread: block, but still work
+  env->dirty = true;
+}
 
+// Swaps in the result of the task, on the UI thread.
+static void finish_task(Env *env) {
+  Task *task = &env->task;
+  if (task->thread) SDL_WaitThread(task->thread, NULL);
+  game result = task->game;
+  task->game = NULL;
+  if (task->kind == TASK_SOLVE && result) {
+    for (uint i = 0; i < game_nb_rows(result); i++) {
+      for (uint j = 0; j < game_nb_cols(result); j++) {
+        game_set_color(env->game_instance, i, j, game_get_color(result, i, j));
+      }
+    }
+    game_delete(result);
+    refresh_status(env);
+    invalidate_board(env);
+  } else if (task->kind == TASK_SOLVE) {
+    env->noSolution = true;
+  } else if (result) {
+    game_delete(env->game_instance);
+    env->game_instance = result;
+    reset_board(env);
+  }
+  task->kind = TASK_NONE;
+  env->dirty = true;
+}
+
+/* **************************************************************** */
+
+static bool pool_progress(const game_solver_stats *stats, void *data) {
+  Pool *pool = data;
+  return SDL_AtomicGet(&pool->quit) == 0;
+}
+
+static bool pool_accepts(const Pool *pool, cgame g) {
+  return game_nb_rows(g) == pool->config.nb_rows &&
+         game_nb_cols(g) == pool->config.nb_cols &&
+         game_is_wrapping(g) == pool->config.wrapping &&
+         game_get_neighbourhood(g) == pool->config.neigh;
+}
+
+// Producer thread.
+static int pool_run(void *data) {
+  Pool *pool = data;
+  while (SDL_AtomicGet(&pool->quit) == 0) {
+    SDL_LockMutex(pool->lock);
+    while (pool->size >= POOL_LOW && SDL_AtomicGet(&pool->quit) == 0) {
+      SDL_CondWait(pool->low, pool->lock);
+    }
+    int missing = POOL_SIZE - pool->size;
+    SDL_UnlockMutex(pool->lock);
+
+    // generation happens outside the lock, so pool_pop never waits for it
+    for (int n = 0; n < missing; n++) {
+      game g = generate_puzzle(&pool->config, &pool->random_state,
+                               &pool->quit, pool_progress, pool);
+      if (!g) break;
+      SDL_LockMutex(pool->lock);
+      pool->games[pool->size++] = g;
+      SDL_UnlockMutex(pool->lock);
+    }
+  }
+  return 0;
+}
+
+// Fills the pool from the file saved by the previous run, if any.
+static void pool_load(Pool *pool) {
+  FILE *file = pool->file ? fopen(pool->file, "r") : NULL;
+  if (!file) return;
+  game g;
+  while (pool->size < POOL_SIZE && (g = game_load_file(file)) != NULL) {
+    if (pool_accepts(pool, g) && game_nb_solutions(g) > 0) {
+      game_restart(g);
+      pool->games[pool->size++] = g;
+    } else {
+      game_delete(g);
+    }
+  }
+  fclose(file);
+}
+
+static void pool_save(Pool *pool) {
+  FILE *file = pool->file ? fopen(pool->file, "w") : NULL;
+  if (!file) return;
+  for (int n = 0; n < pool->size; n++) game_save_file(pool->games[n], file);
+  fclose(file);
+}
+
+static void pool_start(Pool *pool, rng *random_state) {
+  pool->config = RANDOM_CONFIG;
+  pool->size = 0;
+  pool->file = getenv("GAME_POOL");
+  pool_load(pool);
+  // a jump gives the producer a stream that never overlaps the UI one
+  pool->random_state = *random_state;
+  rng_jump(random_state);
+  SDL_AtomicSet(&pool->quit, 0);
+  pool->lock = SDL_CreateMutex();
+  pool->low = SDL_CreateCond();
+  pool->thread = (pool->lock && pool->low)
+                     ? SDL_CreateThread(pool_run, "pool", pool)
+                     : NULL;
+}
+
+// Returns a ready puzzle, or NULL if the pool is empty.
+static game pool_pop(Pool *pool) {
+  if (!pool->thread) return NULL;
+  SDL_LockMutex(pool->lock);
+  game g = (pool->size > 0) ? pool->games[--pool->size] : NULL;
+  if (pool->size < POOL_LOW) SDL_CondSignal(pool->low);
+  SDL_UnlockMutex(pool->lock);
+  return g;
+}
+
+static void pool_stop(Pool *pool) {
+  if (pool->thread) {
+    SDL_LockMutex(pool->lock);
+    SDL_AtomicSet(&pool->quit, 1);
+    SDL_CondSignal(pool->low);
+    SDL_UnlockMutex(pool->lock);
+    SDL_WaitThread(pool->thread, NULL);
+  }
+  if (pool->low) SDL_DestroyCond(pool->low);
+  if (pool->lock) SDL_DestroyMutex(pool->lock);
+  pool_save(pool);
+  for (int n = 0; n < pool->size; n++) game_delete(pool->games[n]);
+  pool->size = 0;
 }
 
 /* **************************************************************** */
@@ -73,26 +805,29 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
         env->game_instance = game_load(argv[1]);
         if (env->game_instance == NULL) {
             fprintf(stderr, "Échec du chargement du jeu à partir du fichier : %s\n", argv[1]);
+            env->game_instance = game_default();
         }
     } else {
         env->game_instance = game_default();
     }
 
+    // Graine du générateur aléatoire, tirée une seule fois
+    rng_seed(&env->random_state, time(NULL));
+
     // Initialisation de la couleur du texte et de la police
     env->textColor = (SDL_Color){0, 128, 128, 255};  // Bleu
-    env->font = TTF_OpenFont(FONT_PATH, FONT_SIZE);
-    if (!env->font) {
-        printf("Échec du chargement de la police : %s\n", TTF_GetError());
-        exit(EXIT_FAILURE);
-    }
+    env->font = NULL;
+    env->atlas = NULL;
 
     // Définition de la taille initiale des cellules
-    env->cellSize = MIN_CELL_SIZE;
+    env->cellSize = DEFAULT_CELL_SIZE;
+    env->zoom = DEFAULT_CELL_SIZE;
 
     // Initialisation de la sélection de la cellule
     env->cellSelected = false;
     env->selectedRow = -1;
     env->selectedCol = -1;
+    env->noSolution = false;
 
     // Labels des boutons
     const char *buttonLabels[NUM_BUTTONS] = {
@@ -125,6 +860,33 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
         env->buttons[i].text[sizeof(env->buttons[i].text) - 1] = '\0';  // Assure la null-termination
     }
 
+    // Chargement de la police et pré-rendu des textes dans l'atlas
+    set_font_size(ren, env, FONT_SIZE);
+
+    // Premier affichage : tout le plateau est à dessiner
+    env->board = NULL;
+    env->lod = NULL;
+    env->lodPixels = NULL;
+    env->lodWidth = env->lodHeight = 0;
+    env->dirtyCells = NULL;
+    env->dirtyList = NULL;
+    env->statusCache = NULL;
+    env->pendingCells = NULL;
+    reset_board(env);
+
+    // Aucune tâche de fond au départ
+    env->task.kind = TASK_NONE;
+    env->task.id = 0;
+    env->task.thread = NULL;
+    env->task.game = NULL;
+    env->task.eventType = SDL_RegisterEvents(2);
+    if (env->task.eventType == (Uint32)-1) {
+        ERROR("Error: SDL_RegisterEvents (%s)", SDL_GetError());
+    }
+
+    // Réserve de jeux aléatoires, remplie en arrière-plan
+    pool_start(&env->pool, &env->random_state);
+
     return env;
 }
 
@@ -132,6 +894,7 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
 /* **************************************************************** */
 
 void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
+  TRACE_SCOPE("render");
   // Clear screen with a grey background
   SDL_SetRenderDrawColor(ren, 188, 188, 188, 188);  // grey
   SDL_RenderClear(ren);
@@ -140,80 +903,21 @@ void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   int winWidth, winHeight;
   SDL_GetWindowSize(win, &winWidth, &winHeight);
 
-  // Calculate total grid size
-  int gridWidth = env->cellSize * game_nb_cols(env->game_instance);
-  int gridHeight = env->cellSize * game_nb_rows(env->game_instance);
-
-  // Calculate offset to center the grid
-  int offsetX = (winWidth - gridWidth) / 2;
-  int offsetY = (winHeight - gridHeight) / 2;
-
-  // Set the draw color for grid lines
-  SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);  // Black
-
-  char textBuffer[12];
-  // Buffer for text rendering
-
-  // Draw vertical lines and column numbers
-  for (int col = 0; col <= game_nb_cols(env->game_instance); col++) {
-    int x = col * env->cellSize + offsetX;
-    SDL_RenderDrawLine(ren, x, offsetY, x, gridHeight + offsetY);
-  }
-
-  // Draw horizontal lines and row numbers
-
-  for (int row = 0; row <= game_nb_rows(env->game_instance); row++) {
-    int y = row * env->cellSize + offsetY;
-    SDL_RenderDrawLine(ren, offsetX, y, gridWidth + offsetX, y);
-  }
-
-  for (int row = 0; row < game_nb_rows(env->game_instance); row++) {
-    for (int col = 0; col < game_nb_cols(env->game_instance); col++) {
-      int cellX = col * env->cellSize + offsetX;
-      int cellY = row * env->cellSize + offsetY;
-      SDL_Rect cellRect = {cellX, cellY, env->cellSize, env->cellSize};
-
-      // Set squares' colors
-      switch (game_get_color(env->game_instance, row, col)) {
-        case BLACK:
-          SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);  // Black
-          SDL_RenderFillRect(ren, &cellRect);
-          break;
-        case WHITE:
-          SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);  // White
-          SDL_RenderFillRect(ren, &cellRect);
-          break;
-
-        default:
-
-          break;
-      }
+  // Repaint the changed squares, then copy the visible part of the board
+  if (env->viewReset) fit_view(env, winWidth, winHeight);
+  draw_board(ren, env, winWidth, winHeight);
+
+  if (is_won(env)) {
+    int x0, y0;
+    board_origin(env, winWidth, winHeight, &x0, &y0);
+    int gridHeight = (int)(env->zoom * game_nb_rows(env->game_instance));
+    int textX = (winWidth - env->wonRect.w) / 2;
+    int textY = y0 + gridHeight + 20;
+    if (textY > winHeight - env->wonRect.h - 10) {
+      textY = winHeight - env->wonRect.h - 10;
     }
+    draw_text(ren, env, &env->wonRect, textX, textY);
   }
-  if (game_won(env->game_instance)) {
-    int textWidth, textHeight;
-    TTF_SizeText(env->font, "Game Won", &textWidth, &textHeight);
-    int textX = (winWidth - textWidth) / 2;
-    int textY = offsetY + gridHeight + 20;
-    renderText(ren, textX, textY, "Game Won", env->font,
-               (SDL_Color){0, 128, 128, 255});
-  }
-
-for (int col = 0; col < game_nb_cols(env->game_instance); col++) {
-    for (int row = 0; row < game_nb_rows(env->game_instance); row++) {
-        int x = col * env->cellSize + offsetX;
-        int y = row * env->cellSize + offsetY;
-        SDL_RenderDrawLine(ren, offsetX, y, gridWidth + offsetX, y);
-
-        int constraint = game_get_constraint(env->game_instance, row, col);
-        if (constraint != -1) {
-            SDL_Color textColor = (game_get_status(env->game_instance, row, col) == ERROR) ? (SDL_Color){255, 0, 1, 0} : env->textColor;
-            sprintf(textBuffer, "%d", constraint);
-            renderText(ren, x + 5, y + 5, textBuffer, env->font, textColor);
-        }
-    }
-}
-
 
   // Calculate button positions based on the current window size
   int buttonWidth = 100;
@@ -236,40 +940,140 @@ for (int col = 0; col < game_nb_cols(env->game_instance); col++) {
     SDL_RenderFillRect(ren, &env->buttons[i].rect);
 
     // Render button text
-    renderText(ren, env->buttons[i].rect.x + 5,
-               env->buttons[i].rect.y + (env->buttons[i].rect.h / 4),
-               env->buttons[i].text, env->font,
-               (SDL_Color){255, 255, 255, 255});
+    draw_text(ren, env, &env->labelRects[i], env->buttons[i].rect.x + 5,
+              env->buttons[i].rect.y + (env->buttons[i].rect.h / 4));
   }
 
-  SDL_RenderPresent(ren); /* PUT YOUR CODE HERE TO RENDER TEXTURES, ... */
+  // Progress of the background task
+  if (env->task.kind != TASK_NONE) {
+    const SDL_Rect *text = &env->taskRects[env->task.kind];
+    int barX = (winWidth - PROGRESS_WIDTH) / 2;
+    int barY = buttonY + buttonHeight + 10;
+    draw_text(ren, env, text, barX, barY);
+    if (env->task.kind == TASK_SOLVE) {
+      int permille = SDL_AtomicGet(&env->task.permille);
+      SDL_Rect frame = {barX, barY + text->h + 2, PROGRESS_WIDTH, 6};
+      SDL_Rect bar = {barX, barY + text->h + 2,
+                      PROGRESS_WIDTH * permille / 1000, 6};
+      SDL_SetRenderDrawColor(ren, 120, 120, 255, 255);
+      SDL_RenderFillRect(ren, &bar);
+      SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+      SDL_RenderDrawRect(ren, &frame);
+    }
+  } else if (env->noSolution) {
+    draw_text(ren, env, &env->noSolutionRect,
+              (winWidth - env->noSolutionRect.w) / 2,
+              buttonY + buttonHeight + 10);
+  }
+
+  env->dirty = false;
 }
 
 /* **************************************************************** */
 
+bool needs_render(Env *env) { return env->dirty; }
+
+/* **************************************************************** */
+
 bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
+  TRACE_SCOPE("process");
   if (e->type == SDL_QUIT) {
     return true;
-  } else if (e->type == SDL_MOUSEBUTTONDOWN) {
+  } else if (e->type == SDL_WINDOWEVENT) {
+    // resized, exposed, restored...: the content may be lost or misplaced
+    if (e->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) invalidate_board(env);
+    env->dirty = true;
+  } else if (e->type == SDL_RENDER_TARGETS_RESET ||
+             e->type == SDL_RENDER_DEVICE_RESET) {
+    // the content of the board texture was lost
+    invalidate_board(env);
+  } else if (e->type == env->task.eventType ||
+             e->type == env->task.eventType + 1) {
+    // events of a cancelled task are ignored
+    if (env->task.kind == TASK_NONE || e->user.code != env->task.id) {
+      return false;
+    }
+    if (e->type == env->task.eventType) {
+      env->dirty = true;  // progress
+    } else {
+      finish_task(env);
+    }
+  } else if (e->type == SDL_MOUSEWHEEL) {
+    // zoom around the mouse pointer
+    int mouseX, mouseY, winWidth, winHeight;
+    SDL_GetMouseState(&mouseX, &mouseY);
+    SDL_GetWindowSize(win, &winWidth, &winHeight);
+    if (e->wheel.y != 0) {
+      double factor = (e->wheel.y > 0) ? ZOOM_STEP : 1 / ZOOM_STEP;
+      zoom_at(env, winWidth, winHeight, factor, mouseX, mouseY);
+    }
+  } else if (e->type == SDL_MOUSEMOTION) {
+    // drag with the right button to pan
+    if (e->motion.state & SDL_BUTTON(SDL_BUTTON_RIGHT)) {
+      pan(env, -e->motion.xrel, -e->motion.yrel);
+    }
+  } else if (e->type == SDL_KEYDOWN) {
+    int winWidth, winHeight;
+    SDL_GetWindowSize(win, &winWidth, &winHeight);
+    switch (e->key.keysym.sym) {
+      case SDLK_PLUS:
+      case SDLK_EQUALS:
+      case SDLK_KP_PLUS:
+        zoom_at(env, winWidth, winHeight, ZOOM_STEP, winWidth / 2,
+                winHeight / 2);
+        break;
+      case SDLK_MINUS:
+      case SDLK_KP_MINUS:
+        zoom_at(env, winWidth, winHeight, 1 / ZOOM_STEP, winWidth / 2,
+                winHeight / 2);
+        break;
+      case SDLK_LEFT:
+        pan(env, -PAN_STEP * winWidth, 0);
+        break;
+      case SDLK_RIGHT:
+        pan(env, PAN_STEP * winWidth, 0);
+        break;
+      case SDLK_UP:
+        pan(env, 0, -PAN_STEP * winHeight);
+        break;
+      case SDLK_DOWN:
+        pan(env, 0, PAN_STEP * winHeight);
+        break;
+      case SDLK_0:
+        env->viewReset = true;
+        env->dirty = true;
+        break;
+    }
+  } else if (e->type == SDL_MOUSEBUTTONDOWN &&
+             e->button.button == SDL_BUTTON_LEFT) {
+    env->noSolution = false;
+    env->dirty = true;
     // Get click position
     int mouseX, mouseY;
     SDL_GetMouseState(&mouseX, &mouseY);
 
-    // Calculate grid offset based on window size
+    // Find the clicked cell from the view
     int winWidth, winHeight;
     SDL_GetWindowSize(win, &winWidth, &winHeight);
-    int offsetX =
-        (winWidth - env->cellSize * game_nb_cols(env->game_instance)) / 2;
-    int offsetY =
-        (winHeight - env->cellSize * game_nb_rows(env->game_instance)) / 2;
-
-    // Check if click is within the grid
-    if (mouseX >= offsetX &&
-        mouseX < offsetX + env->cellSize * game_nb_cols(env->game_instance) &&
-        mouseY >= offsetY &&
-        mouseY < offsetY + env->cellSize * game_nb_rows(env->game_instance)) {
-      int clickedCol = (mouseX - offsetX) / env->cellSize;
-      int clickedRow = (mouseY - offsetY) / env->cellSize;
+    int offsetX, offsetY;
+    board_origin(env, winWidth, winHeight, &offsetX, &offsetY);
+    int clickedCol = (int)floor((mouseX - offsetX) / env->zoom);
+    int clickedRow = (int)floor((mouseY - offsetY) / env->zoom);
+    bool onButton = false;
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+      if (SDL_PointInRect(&((SDL_Point){mouseX, mouseY}),
+                          &env->buttons[i].rect)) {
+        onButton = true;
+      }
+    }
+
+    // Check if click is within the grid, at a zoom where cells can be seen
+    if (!onButton && env->zoom >= LOD_CELL_SIZE && clickedCol >= 0 &&
+        clickedCol < (int)game_nb_cols(env->game_instance) && clickedRow >= 0 &&
+        clickedRow < (int)game_nb_rows(env->game_instance)) {
+
+      // a pending solution would overwrite the move
+      cancel_task(env);
 
       // color squares on click
       if (game_get_color(env->game_instance, clickedRow, clickedCol) == EMPTY) {
@@ -281,10 +1085,12 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
                  WHITE) {
         game_play_move(env->game_instance, clickedRow, clickedCol, EMPTY);
       }
+      invalidate_cell(env, clickedRow, clickedCol);
     }
     for (int i = 0; i < NUM_BUTTONS; i++) {
       if (SDL_PointInRect(&((SDL_Point){mouseX, mouseY}),
                           &env->buttons[i].rect)) {
+        if (env->buttons[i].id <= 3) cancel_task(env);
         switch (env->buttons[i].id) {
           case 1:  // Restart Game
             game_restart(env->game_instance);
@@ -293,46 +1099,48 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
                 game_set_color(env->game_instance, row, col, EMPTY);
               }
             }
+            refresh_status(env);
+            invalidate_board(env);
 
             break;
           case 2:  // Undo Move
-
-            game_undo(env->game_instance);
+            if (game_current_move(env->game_instance) > 0) {
+              game g = env->game_instance;
+              move_t move = g->history[g->current_move - 1];
+              game_undo(g);
+              invalidate_cell(env, move.i, move.j);
+            }
 
             break;
           case 3:  // Redo Move
-            game_redo(env->game_instance);
+            if (game_current_move(env->game_instance) <
+                game_nb_moves(env->game_instance)) {
+              game g = env->game_instance;
+              move_t move = g->history[g->current_move];
+              game_redo(g);
+              invalidate_cell(env, move.i, move.j);
+            }
             break;
           case 4:  // Solve Game
-
-            game_solve(env->game_instance);
-
+            start_task(env, TASK_SOLVE);
             break;
-          case 5:
-
-            srand(time(NULL));  // initialize radom seed with current time
-            bool wrapping = false;
-            neighbourhood neigh = FULL;
-            game random = game_random(4, 4, wrapping, neigh, true, 0.6f, 0.5f);
-            if (game_nb_solutions(random) != 0) {
-              env->game_instance = random;
-              game_restart(env->game_instance);
-
+          case 5: {  // Random Game
+            game g = pool_pop(&env->pool);
+            if (g) {
+              cancel_task(env);
+              game_delete(env->game_instance);
+              env->game_instance = g;
+              reset_board(env);
             } else {
-              while (game_nb_solutions(random) == 0) {
-                random = game_random(4, 4, wrapping, neigh, false, 0.6f, 0.5f);
-                if (game_nb_solutions(random) != 0) {
-                  env->game_instance = random;
-                  game_restart(env->game_instance);
-                  break;
-                }
-              }
+              start_task(env, TASK_RANDOM);  // empty pool: generate one
             }
+            break;
+          }
         }
         return false;
       }
     }
-    if (game_won(env->game_instance)) {
+    if (is_won(env)) {
       printf("game won");
     }
   }
@@ -344,9 +1152,26 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
 
 void clean(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   /* PUT YOUR CODE HERE TO CLEAN MEMORY */
+  cancel_task(env);
+  pool_stop(&env->pool);
+  game_delete(env->game_instance);
   if (env->font) {
     TTF_CloseFont(env->font);
   }
+  if (env->atlas) {
+    SDL_DestroyTexture(env->atlas);
+  }
+  if (env->board) {
+    SDL_DestroyTexture(env->board);
+  }
+  if (env->lod) {
+    SDL_DestroyTexture(env->lod);
+  }
+  free(env->lodPixels);
+  free(env->dirtyCells);
+  free(env->dirtyList);
+  free(env->statusCache);
+  free(env->pendingCells);
   free(env);
 }
 
@@ -38,7 +38,7 @@ typedef struct Env_t Env;
 #define APP_NAME "Mosaic-b10"
 #define SCREEN_WIDTH 600
 #define SCREEN_HEIGHT 600
-#define DELAY 100
+#define WAIT_TIMEOUT 500  // ms, longest sleep of the main loop without events
 
 /* **************************************************************** */
 
@@ -46,6 +46,7 @@ Env* init(SDL_Window* win, SDL_Renderer* ren, int argc, char* argv[]);
 void render(SDL_Window* win, SDL_Renderer* ren, Env* env);
 void clean(SDL_Window* win, SDL_Renderer* ren, Env* env);
 bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e);
+bool needs_render(Env* env);
 
 /* **************************************************************** */
 
@@ -0,0 +1,942 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "grid.h"
+#include "rng.h"
+#include "trace.h"
+
+#define MAX_FIELDS 16
+#define DEFAULT_BUDGET 1000  // milliseconds allowed to solve and count
+#define CHECK_INTERVAL 1024  // solver nodes between two budget checks
+
+// JSON-RPC error codes, and ours
+#define PARSE_ERROR -32700
+#define INVALID_REQUEST -32600
+#define METHOD_NOT_FOUND -32601
+#define INVALID_PARAMS -32602
+#define BUDGET_EXCEEDED 1
+#define UNKNOWN_GAME 2
+
+/* ******************** requests ******************** */
+
+typedef enum { VALUE_NULL, VALUE_BOOL, VALUE_NUMBER, VALUE_STRING } value_type;
+
+typedef struct {
+  char *key;
+  value_type type;
+  double number;  // also 0 or 1 for booleans
+  char *string;
+} field;
+
+typedef enum {
+  LOAD,
+  GENERATE,
+  PLAY,
+  UNDO,
+  REDO,
+  STATUS,
+  SOLVE,
+  COUNT,
+  DELETE,
+  NB_METHODS
+} method;
+
+static const char *METHOD_NAMES[NB_METHODS] = {
+    "load", "generate", "play",  "undo",  "redo",
+    "status", "solve",  "count", "delete"};
+
+typedef struct {
+  int fd;
+  bool close_fd;  // the standard output is left open
+  pthread_mutex_t lock;
+  int refs;  // the reader and the pending requests
+} connection;
+
+struct entry_s;
+
+typedef struct job_s {
+  connection *conn;
+  char *id;  // raw JSON id, echoed in the response
+  method m;
+  field fields[MAX_FIELDS];  // the params, and unknown top-level keys
+  uint nb_fields;
+  struct entry_s *entry;  // the game, created on submission by load/generate
+  uint handle;            // its handle
+  double deadline;        // for the slow methods, in seconds
+  struct job_s *next;     // in its ready queue
+  struct job_s *later;    // next request on the same game
+} job;
+
+// The requests on a resident game are run one at a time, in their order of
+// arrival: only the head of its list is in a ready queue or running. The
+// handle is reserved when load or generate is received, so that a client may
+// pipeline requests on a game before knowing that it was created.
+typedef struct entry_s {
+  game g;       // NULL until loaded, or once deleted
+  bool closed;  // deleted or failed to load, new requests are refused
+  job *head, *tail;
+} entry;
+
+typedef struct {
+  job *head, *tail;
+} job_queue;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t ready;  // a job was queued, or the server stops
+  pthread_cond_t idle;   // every request was answered
+  job_queue fast, slow;  // solve, count and generate are slow
+  uint nb_slow, max_slow;
+  uint nb_pending;  // requests not answered yet
+  entry **entries;  // game handle h is entries[h - 1]
+  uint nb_entries, capacity;
+  uint budget;  // default budget, in milliseconds
+  uint64_t next_seed;
+  bool stopping;
+} server = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+            PTHREAD_COND_INITIALIZER};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ******************** JSON parsing ******************** */
+
+static void skip_spaces(const char **p) {
+  while (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n') (*p)++;
+}
+
+// Returns the JSON string starting at *p, or NULL. Only ASCII \u escapes are
+// supported.
+static char *parse_string(const char **p) {
+  skip_spaces(p);
+  if (**p != '"') return NULL;
+  const char *s = *p + 1;
+  char *out = malloc(strlen(s) + 1);  // escapes only shrink the string
+  size_t len = 0;
+  bool valid = true;
+  while (out && valid && *s && *s != '"') {
+    char c = *s++;
+    if (c == '\\') {
+      c = *s++;
+      if (c == 'n') {
+        c = '\n';
+      } else if (c == 't') {
+        c = '\t';
+      } else if (c == 'r') {
+        c = '\r';
+      } else if (c == 'b') {
+        c = '\b';
+      } else if (c == 'f') {
+        c = '\f';
+      } else if (c == 'u') {
+        unsigned int code = 0;
+        for (int k = 0; k < 4 && code < 0x100; k++) {
+          char h = *s++;
+          if (h >= '0' && h <= '9') {
+            code = (code << 4) | (h - '0');
+          } else if (h >= 'a' && h <= 'f') {
+            code = (code << 4) | (h - 'a' + 10);
+          } else if (h >= 'A' && h <= 'F') {
+            code = (code << 4) | (h - 'A' + 10);
+          } else {
+            code = 0x100;  // not a hexadecimal digit
+          }
+        }
+        valid = code > 0 && code <= 0x7F;
+        c = code;
+      } else if (c != '"' && c != '\\' && c != '/') {
+        valid = false;  // unknown escape, or end of line
+      }
+    }
+    out[len++] = c;
+  }
+  if (!out || !valid || *s != '"') {
+    free(out);
+    return NULL;
+  }
+  out[len] = '\0';
+  *p = s + 1;
+  return out;
+}
+
+static const char *skip_digits(const char *s) {
+  while (*s >= '0' && *s <= '9') s++;
+  return s;
+}
+
+// Returns the end of the JSON number starting at s, or s if there is none:
+// unlike strtod, no hexadecimal, infinity, nan or leading '+'.
+static const char *number_end(const char *s) {
+  const char *start = s;
+  if (*s == '-') s++;
+  if (*s == '0') {
+    s++;
+  } else if (*s >= '1' && *s <= '9') {
+    s = skip_digits(s);
+  } else {
+    return start;
+  }
+  if (*s == '.') {
+    if (s[1] < '0' || s[1] > '9') return start;
+    s = skip_digits(s + 1);
+  }
+  if (*s == 'e' || *s == 'E') {
+    s++;
+    if (*s == '+' || *s == '-') s++;
+    if (*s < '0' || *s > '9') return start;
+    s = skip_digits(s);
+  }
+  return s;
+}
+
+static bool parse_value(const char **p, field *f) {
+  skip_spaces(p);
+  f->string = NULL;
+  f->number = 0;
+  if (**p == '"') {
+    f->type = VALUE_STRING;
+    f->string = parse_string(p);
+    return f->string != NULL;
+  }
+  const char *words[] = {"null", "false", "true"};
+  for (int k = 0; k < 3; k++) {
+    if (strncmp(*p, words[k], strlen(words[k])) == 0) {
+      f->type = k == 0 ? VALUE_NULL : VALUE_BOOL;
+      f->number = k == 2;
+      *p += strlen(words[k]);
+      return true;
+    }
+  }
+  const char *end = number_end(*p);
+  if (end == *p) return false;
+  f->type = VALUE_NUMBER;
+  f->number = strtod(*p, NULL);
+  if (!isfinite(f->number)) return false;  // 1e999
+  *p = end;
+  return true;
+}
+
+// Parses the request object; the members of "params" are added to the fields
+// as if they were at the top level.
+static bool parse_object(const char **p, job *jb, char **method_name,
+                         bool top) {
+  skip_spaces(p);
+  if (**p != '{') return false;
+  (*p)++;
+  skip_spaces(p);
+  if (**p == '}') {
+    (*p)++;
+    return true;
+  }
+  for (;;) {
+    char *key = parse_string(p);
+    if (!key) return false;
+    skip_spaces(p);
+    if (**p != ':') {
+      free(key);
+      return false;
+    }
+    (*p)++;
+    skip_spaces(p);
+    field f;
+    bool ok;
+    if (top && strcmp(key, "params") == 0) {
+      ok = parse_object(p, jb, method_name, false);
+      free(key);
+    } else if (top && strcmp(key, "id") == 0) {
+      const char *start = *p;
+      ok = parse_value(p, &f);
+      free(f.string);
+      free(key);
+      free(jb->id);
+      jb->id = ok ? strndup(start, *p - start) : NULL;
+    } else if (top && strcmp(key, "method") == 0) {
+      ok = parse_value(p, &f) && f.type == VALUE_STRING;
+      free(*method_name);
+      *method_name = f.string;
+      free(key);
+    } else if (jb->nb_fields < MAX_FIELDS && parse_value(p, &f)) {
+      f.key = key;
+      jb->fields[jb->nb_fields++] = f;
+      ok = true;
+    } else {
+      free(key);
+      ok = false;
+    }
+    if (!ok) return false;
+    skip_spaces(p);
+    if (**p == '}') {
+      (*p)++;
+      return true;
+    }
+    if (**p != ',') return false;
+    (*p)++;
+  }
+}
+
+static field *get_field(job *jb, const char *key) {
+  for (uint k = 0; k < jb->nb_fields; k++) {
+    if (strcmp(jb->fields[k].key, key) == 0) return &jb->fields[k];
+  }
+  return NULL;
+}
+
+// Reads an optional unsigned integer parameter; false if it is invalid.
+static bool get_uint(job *jb, const char *key, uint *value) {
+  field *f = get_field(jb, key);
+  if (!f) return true;
+  if ((f->type != VALUE_NUMBER && f->type != VALUE_BOOL) || f->number < 0 ||
+      f->number > UINT32_MAX || f->number != floor(f->number))
+    return false;
+  *value = f->number;
+  return true;
+}
+
+static bool get_float(job *jb, const char *key, float *value) {
+  field *f = get_field(jb, key);
+  if (!f) return true;
+  if (f->type != VALUE_NUMBER) return false;
+  *value = f->number;
+  return true;
+}
+
+static void free_job(job *jb) {
+  for (uint k = 0; k < jb->nb_fields; k++) {
+    free(jb->fields[k].key);
+    free(jb->fields[k].string);
+  }
+  free(jb->id);
+  free(jb);
+}
+
+/* ******************** responses ******************** */
+
+static void release_connection(connection *conn) {
+  pthread_mutex_lock(&conn->lock);
+  bool last = (--conn->refs == 0);
+  pthread_mutex_unlock(&conn->lock);
+  if (!last) return;
+  if (conn->close_fd) close(conn->fd);
+  pthread_mutex_destroy(&conn->lock);
+  free(conn);
+}
+
+// Responses are written whole, so that concurrent ones never interleave.
+static void send_response(connection *conn, const char *buf, size_t len) {
+  pthread_mutex_lock(&conn->lock);
+  while (len > 0) {
+    ssize_t n = write(conn->fd, buf, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;  // the client is gone
+    buf += n;
+    len -= n;
+  }
+  pthread_mutex_unlock(&conn->lock);
+}
+
+static void write_json_string(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(out, "\\%c", *s);
+    } else if (*s == '\n') {
+      fputs("\\n", out);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(out, "\\u%04x", *s);
+    } else {
+      fputc(*s, out);
+    }
+  }
+  fputc('"', out);
+}
+
+static void write_game_text(FILE *out, cgame g) {
+  char *text;
+  size_t len;
+  FILE *f = open_memstream(&text, &len);
+  game_save_file(g, f);
+  fclose(f);
+  write_json_string(out, text);
+  free(text);
+}
+
+static void write_status(FILE *out, cgame g) {
+  uint nb_empty = 0, nb_errors = 0;
+  status *statuses = malloc(game_nb_rows(g) * game_nb_cols(g) * sizeof(status));
+  game_status_grid(g, statuses);
+  for (uint i = 0; i < game_nb_rows(g); i++) {
+    for (uint j = 0; j < game_nb_cols(g); j++) {
+      if (game_get_color(g, i, j) == EMPTY) nb_empty++;
+      if (statuses[i * game_nb_cols(g) + j] == ERROR) nb_errors++;
+    }
+  }
+  free(statuses);
+  fprintf(out,
+          "\"won\": %s, \"empty\": %u, \"errors\": %u, \"move\": %zu, "
+          "\"nb_moves\": %zu",
+          game_won(g) ? "true" : "false", nb_empty, nb_errors,
+          game_current_move(g), game_nb_moves(g));
+}
+
+/* ******************** methods ******************** */
+
+// Each method either writes its result members and returns 0, or returns an
+// error code and sets the message without writing anything.
+typedef int (*handler)(job *jb, FILE *out, const char **error);
+
+static int do_load(job *jb, FILE *out, const char **error) {
+  field *text = get_field(jb, "text"), *file = get_field(jb, "file");
+  game g = NULL;
+  if (text && text->type == VALUE_STRING) {
+    FILE *in = fmemopen(text->string, strlen(text->string), "r");
+    if (in) {
+      g = game_load_file(in);
+      fclose(in);
+    }
+  } else if (file && file->type == VALUE_STRING) {
+    g = game_load(file->string);
+  } else {
+    *error = "expected a \"text\" or \"file\" parameter";
+    return INVALID_PARAMS;
+  }
+  if (!g) {
+    *error = "invalid game description";
+    return INVALID_PARAMS;
+  }
+  jb->entry->g = g;
+  fprintf(out, "\"game\": %u", jb->handle);
+  return 0;
+}
+
+static int do_generate(job *jb, FILE *out, const char **error) {
+  uint nb_rows = DEFAULT_SIZE, nb_cols = DEFAULT_SIZE, wrapping = 0, neigh = 0;
+  float black_rate = 0.5f, constraint_rate = 0.5f;
+  pthread_mutex_lock(&server.lock);
+  uint64_t seed = server.next_seed++;
+  pthread_mutex_unlock(&server.lock);
+  field *f = get_field(jb, "seed");
+  if (f && (f->type != VALUE_NUMBER || f->number < 0 ||
+            f->number >= 18446744073709551616.0 ||
+            f->number != floor(f->number))) {
+    *error = "invalid generation parameters";
+    return INVALID_PARAMS;
+  }
+  if (f) seed = f->number;
+  if (!get_uint(jb, "rows", &nb_rows) || !get_uint(jb, "cols", &nb_cols) ||
+      !get_uint(jb, "wrapping", &wrapping) || !get_uint(jb, "neigh", &neigh) ||
+      !get_float(jb, "black_rate", &black_rate) ||
+      !get_float(jb, "constraint_rate", &constraint_rate) || nb_rows == 0 ||
+      nb_cols == 0 || (uint64_t)nb_rows * nb_cols > GAME_MAX_SQUARES ||
+      neigh > ORTHO_EXCLUDE || black_rate < 0.0f || black_rate > 1.0f ||
+      constraint_rate < 0.0f || constraint_rate > 1.0f) {
+    *error = "invalid generation parameters";
+    return INVALID_PARAMS;
+  }
+  rng r;
+  rng_seed(&r, seed);
+  game g = game_random_r(nb_rows, nb_cols, wrapping, neigh, false, black_rate,
+                         constraint_rate, &r);
+  if (!g) {
+    *error = "generation failed";
+    return INVALID_PARAMS;
+  }
+  jb->entry->g = g;
+  fprintf(out, "\"game\": %u, \"text\": ", jb->handle);
+  write_game_text(out, g);
+  return 0;
+}
+
+static int do_play(job *jb, FILE *out, const char **error) {
+  game g = jb->entry->g;
+  uint i = UINT32_MAX, j = UINT32_MAX;
+  field *c = get_field(jb, "color");
+  color col = EMPTY;
+  bool ok = c && c->type == VALUE_STRING;
+  if (ok) {
+    if (c->string[0] == 'w') {
+      col = WHITE;
+    } else if (c->string[0] == 'b') {
+      col = BLACK;
+    } else {
+      ok = c->string[0] == 'e';
+    }
+  }
+  if (!ok || !get_uint(jb, "i", &i) || !get_uint(jb, "j", &j) ||
+      i >= game_nb_rows(g) || j >= game_nb_cols(g)) {
+    *error = "expected \"i\", \"j\" in the grid and a \"color\" w, b or e";
+    return INVALID_PARAMS;
+  }
+  game_play_move(g, i, j, col);
+  write_status(out, g);
+  return 0;
+}
+
+static int do_undo(job *jb, FILE *out, const char **error) {
+  game_undo(jb->entry->g);
+  write_status(out, jb->entry->g);
+  return 0;
+}
+
+static int do_redo(job *jb, FILE *out, const char **error) {
+  game_redo(jb->entry->g);
+  write_status(out, jb->entry->g);
+  return 0;
+}
+
+static int do_status(job *jb, FILE *out, const char **error) {
+  write_status(out, jb->entry->g);
+  fprintf(out, ", \"text\": ");
+  write_game_text(out, jb->entry->g);
+  return 0;
+}
+
+static bool within_budget(const game_solver_stats *stats, void *data) {
+  return now() < *(double *)data;
+}
+
+static int do_solve(job *jb, FILE *out, const char **error) {
+  game_solver_stats stats;
+  bool found = game_solve_ext(jb->entry->g, &stats, within_budget,
+                              &jb->deadline, CHECK_INTERVAL);
+  if (stats.cancelled) {
+    *error = "time budget exceeded";
+    return BUDGET_EXCEEDED;
+  }
+  fprintf(out, "\"solved\": %s, \"nodes\": %llu, \"elapsed\": %.6f",
+          found ? "true" : "false", (unsigned long long)stats.nb_nodes,
+          stats.elapsed);
+  return 0;
+}
+
+static int do_count(job *jb, FILE *out, const char **error) {
+  game_solver_stats stats;
+  uint64_t nb = game_nb_solutions_ext(jb->entry->g, &stats, within_budget,
+                                      &jb->deadline, CHECK_INTERVAL);
+  if (stats.cancelled) {
+    *error = "time budget exceeded";
+    return BUDGET_EXCEEDED;
+  }
+  fprintf(out, "\"count\": %llu, \"nodes\": %llu, \"elapsed\": %.6f",
+          (unsigned long long)nb, (unsigned long long)stats.nb_nodes,
+          stats.elapsed);
+  return 0;
+}
+
+static int do_delete(job *jb, FILE *out, const char **error) {
+  game_delete(jb->entry->g);
+  jb->entry->g = NULL;
+  pthread_mutex_lock(&server.lock);  // the handle is checked on submission
+  jb->entry->closed = true;
+  pthread_mutex_unlock(&server.lock);
+  fprintf(out, "\"deleted\": true");
+  return 0;
+}
+
+static const handler HANDLERS[NB_METHODS] = {
+    do_load, do_generate, do_play,  do_undo,  do_redo,
+    do_status, do_solve,  do_count, do_delete};
+
+// Generating a large board takes seconds as well, though it has no budget.
+static bool is_slow(method m) {
+  return m == SOLVE || m == COUNT || m == GENERATE;
+}
+
+static void respond_error(connection *conn, const char *id, int code,
+                          const char *message) {
+  char *buf;
+  size_t len;
+  FILE *out = open_memstream(&buf, &len);
+  fprintf(out,
+          "{\"jsonrpc\": \"2.0\", \"id\": %s, \"error\": {\"code\": %d, "
+          "\"message\": ",
+          id ? id : "null", code);
+  write_json_string(out, message);
+  fprintf(out, "}}\n");
+  fclose(out);
+  send_response(conn, buf, len);
+  free(buf);
+}
+
+static void run_job(job *jb) {
+  const char *error = NULL;
+  int code = 0;
+  bool creates = (jb->m == LOAD || jb->m == GENERATE);
+  if (!creates && !jb->entry->g) {
+    code = UNKNOWN_GAME;
+    error = "unknown game";
+  } else if (is_slow(jb->m) && now() >= jb->deadline) {
+    code = BUDGET_EXCEEDED;
+    error = "time budget exceeded";
+  }
+
+  char *result = NULL;
+  size_t len;
+  if (code == 0) {
+    FILE *out = open_memstream(&result, &len);
+    TRACE_BEGIN(METHOD_NAMES[jb->m]);
+    code = HANDLERS[jb->m](jb, out, &error);
+    TRACE_END(METHOD_NAMES[jb->m]);
+    fclose(out);
+  }
+  if (code != 0) {
+    if (creates) {
+      pthread_mutex_lock(&server.lock);
+      jb->entry->closed = true;
+      pthread_mutex_unlock(&server.lock);
+    }
+    respond_error(jb->conn, jb->id, code, error);
+  } else {
+    char *buf;
+    FILE *out = open_memstream(&buf, &len);
+    fprintf(out, "{\"jsonrpc\": \"2.0\", \"id\": %s, \"result\": {%s}}\n",
+            jb->id ? jb->id : "null", result);
+    fclose(out);
+    send_response(jb->conn, buf, len);
+    free(buf);
+  }
+  free(result);
+}
+
+/* ******************** scheduling ******************** */
+
+// Called with the server lock held.
+static entry *new_entry(void) {
+  entry *e = malloc(sizeof(entry));
+  if (!e) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    exit(EXIT_FAILURE);
+  }
+  e->g = NULL;
+  e->closed = false;
+  e->head = e->tail = NULL;
+  if (server.nb_entries == server.capacity) {
+    uint capacity = server.capacity ? 2 * server.capacity : 64;
+    entry **entries = realloc(server.entries, capacity * sizeof(entry *));
+    if (!entries) {
+      fprintf(stderr, "Allocation mémoire échouée\n");
+      exit(EXIT_FAILURE);
+    }
+    server.entries = entries;
+    server.capacity = capacity;
+  }
+  server.entries[server.nb_entries++] = e;
+  return e;
+}
+
+// Called with the server lock held.
+static void push_ready(job *jb) {
+  job_queue *q = is_slow(jb->m) ? &server.slow : &server.fast;
+  jb->next = NULL;
+  if (q->tail) {
+    q->tail->next = jb;
+  } else {
+    q->head = jb;
+  }
+  q->tail = jb;
+  pthread_cond_signal(&server.ready);
+}
+
+// Called with the server lock held. Cheap requests go first, and slow ones
+// never take the last worker so that status calls are always served.
+static job *pop_ready(void) {
+  job_queue *q = NULL;
+  if (server.fast.head) {
+    q = &server.fast;
+  } else if (server.slow.head && server.nb_slow < server.max_slow) {
+    q = &server.slow;
+  }
+  if (!q) return NULL;
+  job *jb = q->head;
+  q->head = jb->next;
+  if (!q->head) q->tail = NULL;
+  return jb;
+}
+
+static void *worker_run(void *arg) {
+  pthread_mutex_lock(&server.lock);
+  for (;;) {
+    job *jb = pop_ready();
+    if (!jb) {
+      if (server.stopping) break;
+      pthread_cond_wait(&server.ready, &server.lock);
+      continue;
+    }
+    if (is_slow(jb->m)) server.nb_slow++;
+    pthread_mutex_unlock(&server.lock);
+
+    run_job(jb);
+
+    pthread_mutex_lock(&server.lock);
+    if (is_slow(jb->m)) {
+      server.nb_slow--;
+      if (server.slow.head) pthread_cond_signal(&server.ready);
+    }
+    // schedule the next request on the same game
+    entry *e = jb->entry;
+    e->head = e->head->later;
+    if (e->head) {
+      push_ready(e->head);
+    } else {
+      e->tail = NULL;
+    }
+    connection *conn = jb->conn;
+    free_job(jb);
+    if (--server.nb_pending == 0) pthread_cond_broadcast(&server.idle);
+    pthread_mutex_unlock(&server.lock);
+    release_connection(conn);
+  }
+  pthread_mutex_unlock(&server.lock);
+  return NULL;
+}
+
+static void submit(connection *conn, const char *line) {
+  job *jb = calloc(1, sizeof(job));
+  if (!jb) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    exit(EXIT_FAILURE);
+  }
+  char *method_name = NULL;
+  const char *p = line;
+  bool ok = parse_object(&p, jb, &method_name, true);
+  skip_spaces(&p);
+  if (!ok || *p != '\0') {
+    respond_error(conn, jb->id, PARSE_ERROR, "invalid JSON object");
+    free(method_name);
+    free_job(jb);
+    return;
+  }
+  jb->m = NB_METHODS;
+  for (method m = 0; method_name && m < NB_METHODS; m++) {
+    if (strcmp(method_name, METHOD_NAMES[m]) == 0) jb->m = m;
+  }
+  free(method_name);
+  if (jb->m == NB_METHODS) {
+    respond_error(conn, jb->id, METHOD_NOT_FOUND, "unknown method");
+    free_job(jb);
+    return;
+  }
+
+  uint budget = server.budget;
+  bool creates = (jb->m == LOAD || jb->m == GENERATE);
+  if (!get_uint(jb, "budget", &budget) ||
+      (!creates && !get_uint(jb, "game", &jb->handle))) {
+    respond_error(conn, jb->id, INVALID_PARAMS, "invalid budget or game");
+    free_job(jb);
+    return;
+  }
+  jb->deadline = now() + budget / 1000.0;
+  jb->conn = conn;
+
+  pthread_mutex_lock(&server.lock);
+  if (creates) {
+    jb->entry = new_entry();
+    jb->handle = server.nb_entries;
+  } else if (jb->handle == 0 || jb->handle > server.nb_entries ||
+             server.entries[jb->handle - 1]->closed) {
+    pthread_mutex_unlock(&server.lock);
+    respond_error(conn, jb->id, UNKNOWN_GAME, "unknown game");
+    free_job(jb);
+    return;
+  } else {
+    jb->entry = server.entries[jb->handle - 1];
+  }
+  pthread_mutex_lock(&conn->lock);
+  conn->refs++;
+  pthread_mutex_unlock(&conn->lock);
+  server.nb_pending++;
+  entry *e = jb->entry;
+  if (!e->head) {
+    e->head = e->tail = jb;
+    push_ready(jb);
+  } else {
+    e->tail->later = jb;  // scheduled once the previous ones are done
+    e->tail = jb;
+  }
+  pthread_mutex_unlock(&server.lock);
+}
+
+/* ******************** connections ******************** */
+
+static connection *new_connection(int fd, bool close_fd) {
+  connection *conn = malloc(sizeof(connection));
+  if (!conn) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    exit(EXIT_FAILURE);
+  }
+  conn->fd = fd;
+  conn->close_fd = close_fd;
+  conn->refs = 1;
+  pthread_mutex_init(&conn->lock, NULL);
+  return conn;
+}
+
+// Reads newline-delimited requests until the end of the stream.
+static void serve(connection *conn, FILE *in) {
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t len;
+  while ((len = getline(&line, &capacity, in)) > 0) {
+    const char *p = line;
+    skip_spaces(&p);
+    if (*p) submit(conn, p);
+  }
+  free(line);
+}
+
+static void *client_run(void *arg) {
+  connection *conn = arg;
+  int fd = dup(conn->fd);
+  FILE *in = fd >= 0 ? fdopen(fd, "r") : NULL;
+  if (in) {
+    serve(conn, in);
+    fclose(in);
+  }
+  release_connection(conn);
+  return NULL;
+}
+
+static int listen_unix(const char *path) {
+  struct sockaddr_un addr;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    fprintf(stderr, "Cannot listen on %s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* ******************** main ******************** */
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -s <socket>   listen on a Unix socket instead of the standard "
+          "input\n"
+          "  -t <threads>  number of worker threads, at least 2 (default: all "
+          "cores)\n"
+          "  -b <ms>       default time budget of solve and count (default "
+          "%d)\n"
+          "  --trace <file> write a Chrome trace of the requests\n",
+          prog, DEFAULT_BUDGET);
+}
+
+int main(int argc, char *argv[]) {
+  long nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  uint nb_threads = nb_cores > 0 ? nb_cores : 1;
+  char *socket_path = NULL;
+  server.budget = DEFAULT_BUDGET;
+  server.next_seed = time(NULL);
+  trace_parse_args(&argc, argv);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:b:h")) != -1) {
+    switch (opt) {
+      case 's':
+        socket_path = optarg;
+        break;
+      case 't':
+        nb_threads = atoi(optarg);
+        break;
+      case 'b':
+        server.budget = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (nb_threads == 0 || optind != argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  // one worker is always left to the cheap requests
+  if (nb_threads < 2) nb_threads = 2;
+  server.max_slow = nb_threads - 1;
+  signal(SIGPIPE, SIG_IGN);  // a client leaving must not stop the server
+
+  pthread_t *workers = malloc(nb_threads * sizeof(pthread_t));
+  if (!workers) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    return EXIT_FAILURE;
+  }
+  for (uint t = 0; t < nb_threads; t++) {
+    pthread_create(&workers[t], NULL, worker_run, NULL);
+  }
+
+  if (socket_path) {
+    int listen_fd = listen_unix(socket_path);
+    if (listen_fd < 0) return EXIT_FAILURE;
+    fprintf(stderr, "Listening on %s with %u workers\n", socket_path,
+            nb_threads);
+    for (;;) {
+      int fd = accept(listen_fd, NULL, NULL);
+      if (fd < 0) {
+        if (errno == EINTR) continue;
+        fprintf(stderr, "accept: %s\n", strerror(errno));
+        break;
+      }
+      pthread_t client;
+      connection *conn = new_connection(fd, true);
+      if (pthread_create(&client, NULL, client_run, conn) != 0) {
+        release_connection(conn);
+        continue;
+      }
+      pthread_detach(client);
+    }
+    close(listen_fd);
+    unlink(socket_path);
+  } else {
+    connection *conn = new_connection(STDOUT_FILENO, false);
+    serve(conn, stdin);
+    release_connection(conn);
+  }
+
+  // answer the pending requests, then stop the workers
+  pthread_mutex_lock(&server.lock);
+  while (server.nb_pending > 0) {
+    pthread_cond_wait(&server.idle, &server.lock);
+  }
+  server.stopping = true;
+  pthread_cond_broadcast(&server.ready);
+  pthread_mutex_unlock(&server.lock);
+  for (uint t = 0; t < nb_threads; t++) pthread_join(workers[t], NULL);
+  free(workers);
+
+  for (uint h = 0; h < server.nb_entries; h++) {
+    game_delete(server.entries[h]->g);
+    free(server.entries[h]);
+  }
+  free(server.entries);
+  return EXIT_SUCCESS;
+}
@@ -1,16 +1,83 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "game.h"
 #include "game_aux.h"
 #include "game_tools.h"
+#include "grid.h"
+#include "trace.h"
+
+#define REPORT_PERIOD 0.5  // seconds between two progress lines
+
+static bool print_progress(const game_solver_stats *stats, void *data) {
+  double *last = data;
+  if (stats->elapsed - *last < REPORT_PERIOD) return true;
+  *last = stats->elapsed;
+  fprintf(stderr,
+          "[%.1fs] %llu nodes (%.0f nodes/s), max depth %u, "
+          "%llu open subtrees, ~%.2f%% explored\n",
+          stats->elapsed, (unsigned long long)stats->nb_nodes,
+          stats->nb_nodes / stats->elapsed, stats->max_depth,
+          (unsigned long long)stats->nb_open, 100.0 * stats->progress);
+  return true;
+}
+
+static void print_stats(const game_solver_stats *stats) {
+  fprintf(stderr,
+          "nodes %llu, propagations %llu, backtracks %llu, max depth %u, "
+          "cache hits %llu, %.3f s\n",
+          (unsigned long long)stats->nb_nodes,
+          (unsigned long long)stats->nb_propagations,
+          (unsigned long long)stats->nb_backtracks, stats->max_depth,
+          (unsigned long long)stats->nb_cache_hits, stats->elapsed);
+}
+
+typedef struct {
+  FILE *file;
+  size_t size;  // bytes of a packed solution
+  char *line;   // 2 * size hexadecimal digits and a newline
+} solution_output;
+
+// Writes a solution as the hexadecimal bytes of its packed coloring, one
+// solution per line, so that solution sets compare with sort and diff.
+static bool print_solution(const uint8_t *bits, void *data) {
+  static const char digits[] = "0123456789abcdef";
+  solution_output *out = data;
+  for (size_t b = 0; b < out->size; b++) {
+    out->line[2 * b] = digits[bits[b] >> 4];
+    out->line[2 * b + 1] = digits[bits[b] & 15];
+  }
+  fwrite(out->line, 1, 2 * out->size + 1, out->file);
+  return !ferror(out->file);
+}
 
 int main(int argc, char *argv[]) {
+  // -v may appear anywhere and is removed from the arguments
+  bool verbose = false;
+  int nb_args = 0;
+  for (int i = 0; i < argc; i++) {
+    if (i > 0 && strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else {
+      argv[nb_args++] = argv[i];
+    }
+  }
+  argc = nb_args;
+  trace_parse_args(&argc, argv);
+
   if (argc < 3) {
-    fprintf(stderr, "Usage: %s <option> <input> [<output>]\n", argv[0]);
+    fprintf(stderr,
+            "Usage: %s [-v] [--trace <file>] <option> <input> [<output>]\n",
+            argv[0]);
     return EXIT_FAILURE;
   }
 
+  game_solver_stats stats;
+  double last_report = 0.0;
+  game_solver_progress progress = verbose ? print_progress : NULL;
+
   char *option = argv[1];
   char *input_file = argv[2];
   char *output_file = (argc > 3) ? argv[3] : NULL;
@@ -22,7 +89,9 @@ int main(int argc, char *argv[]) {
   }
 
   if (option[0] == '-' && option[1] == 's') {
-    if (game_solve(g)) {
+    bool solved = game_solve_ext(g, &stats, progress, &last_report, 0);
+    if (verbose) print_stats(&stats);
+    if (solved) {
       if (output_file) {
         game_save(g, output_file);
       } else {
@@ -34,7 +103,9 @@ int main(int argc, char *argv[]) {
       return EXIT_FAILURE;
     }
   } else if (option[0] == '-' && option[1] == 'c') {
-    int num_solutions = game_nb_solutions(g);
+    unsigned long long num_solutions =
+        game_nb_solutions_ext(g, &stats, progress, &last_report, 0);
+    if (verbose) print_stats(&stats);
     if (output_file) {
       FILE *f = fopen(output_file, "w");
       if (f == NULL) {
@@ -42,11 +113,48 @@ int main(int argc, char *argv[]) {
         game_delete(g);
         return EXIT_FAILURE;
       }
-      fprintf(f, "%d\n", num_solutions);
+      fprintf(f, "%llu\n", num_solutions);
       fclose(f);
     } else {
-      printf("%d\n", num_solutions);
+      printf("%llu\n", num_solutions);
+    }
+  } else if (option[0] == '-' && option[1] == 'a') {
+    solution_output out = {output_file ? fopen(output_file, "w") : stdout,
+                           game_packed_size(g), NULL};
+    if (out.file == NULL) {
+      fprintf(stderr, "error opening output file %s\n", output_file);
+      game_delete(g);
+      return EXIT_FAILURE;
+    }
+    out.line = malloc(2 * out.size + 1);
+    if (out.line == NULL) {
+      fprintf(stderr, "Allocation mémoire échouée\n");
+      exit(EXIT_FAILURE);
+    }
+    out.line[2 * out.size] = '\n';
+    game_for_each_solution(g, print_solution, &out, 0);
+    free(out.line);
+    bool failed = ferror(out.file);
+    if (out.file != stdout) failed |= (fclose(out.file) != 0);
+    if (failed) {
+      fprintf(stderr, "error writing the solutions\n");
+      game_delete(g);
+      return EXIT_FAILURE;
+    }
+  } else if (option[0] == '-' && option[1] == 'r') {
+    static const char *tier_names[] = {"none",      "single", "pair",
+                                       "lookahead", "guess",  "invalid"};
+    rating r = game_rate(g);
+    FILE *f = output_file ? fopen(output_file, "w") : stdout;
+    if (f == NULL) {
+      fprintf(stderr, "error opening output file %s\n", output_file);
+      game_delete(g);
+      return EXIT_FAILURE;
     }
+    fprintf(f, "%s single=%u pair=%u lookahead=%u free=%u unknown=%u\n",
+            tier_names[r.level], r.nb_single, r.nb_pair, r.nb_lookahead,
+            r.nb_free, r.nb_unknown);
+    if (f != stdout) fclose(f);
   } else {
     fprintf(stderr, "invalid option %s\n", option);
     game_delete(g);
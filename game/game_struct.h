@@ -10,7 +10,9 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
-#include "queue.h"
+#include "kernels.h"
+#include "neighbors.h"
+#include "snapshot.h"
 
 typedef struct move_s {
   uint i, j;             // Coordinates of the move
@@ -25,13 +27,54 @@ typedef struct game_s {
   color *colors;
   bool wrapping;
   neighbourhood neigh;
-  move_t *history;       // Array to store history of moves
-  int history_size;      // Size of the history array
-  int current_move;      // Index of the current move in the history
-  int history_capacity;  // Capacity of the history array
-  queue *played_moves;   // Queue for moves that have been played
-  queue *undone_moves;   // Queue for moves that have been undone
-
+  move_t *history;             // Journal of the moves, undone ones included
+  size_t history_size;         // Number of moves in the journal
+  size_t current_move;         // Number of moves applied (undo/redo position)
+  size_t history_capacity;     // Capacity of the history array
+  color *snapshots;            // Colors before moves 0, K, 2K, ... (game_goto)
+  size_t nb_snapshots;         // Number of valid snapshots
+  size_t first_snapshot;       // Oldest snapshot matching the history
+  size_t snapshot_capacity;    // Number of snapshots allocated
+  struct snapshot_s *version;  // Colors at the last game_snapshot, or NULL
+  bool *dirty;                 // Tiles written since the last game_snapshot
+  uint *dirty_list;            // Their indices
+  uint nb_dirty;               // Their number, or ALL_DIRTY
+  const struct neighbor_table_s *neighbors;  // Shared with same-shape games
+  const struct game_kernels_s *kernels;      // Chosen by the neighbourhood
 } * game;
 
+// Number of squares in the neighbourhood window of (i, j), edges included.
+int game_max_neighbors(cgame g, uint i, uint j);
+
+#define ALL_DIRTY ((uint)-1)
+
+// Write sites report the squares they change, so that game_snapshot only
+// refreshes the tiles written since the last snapshot (see snapshot.c).
+void game_mark_dirty(game g, uint index);
+
+static inline void game_touch(game g, uint index) {
+  if (g->version) game_mark_dirty(g, index);
+}
+
+static inline void game_touch_all(game g) {
+  if (g->version) g->nb_dirty = ALL_DIRTY;
+}
+
+// Colors changed outside the history (game_set_color, a solver result...)
+// persist through game_undo and game_redo, while the snapshots taken so far
+// predate them: game_goto stops using those until new ones are taken.
+static inline void game_forget_snapshots(game g) {
+  g->first_snapshot = g->nb_snapshots;
+}
+
+#define SNAPSHOT_MIN_PERIOD 256
+
+// Number of moves K between two snapshots of the journal. Scaling it with the
+// board keeps the snapshots about as large as the journal itself, while
+// game_goto never replays more moves than the board has squares.
+static inline size_t snapshot_period(const struct game_s *g) {
+  size_t nb_squares = (size_t)g->row * g->column;
+  return nb_squares > SNAPSHOT_MIN_PERIOD ? nb_squares : SNAPSHOT_MIN_PERIOD;
+}
+
 #endif
\ No newline at end of file
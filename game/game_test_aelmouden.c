@@ -5,13 +5,10 @@
 
 #include "game.h"
 #include "game_aux.h"
-
-struct game_s {
-  int row;
-  int column;
-  constraint *constraints;
-  color *colors;
-};
+#include "game_struct.h"
+#include "game_tools.h"
+#include "rng.h"
+#include "snapshot.h"
 
 bool test_game_new() {
   uint size = DEFAULT_SIZE;
@@ -90,15 +87,203 @@ int test_game_delete() {
   return EXIT_SUCCESS;
 }
 
-// void test_game_solve() {
-//     game g= game_default();
+bool test_game_solve() {
+  game g = game_default();
+  game solution = game_default_solution();
+  bool ok = game_solve(g) && game_won(g) && game_equal(g, solution);
+  ok = ok && game_nb_solutions(g) == 1;
+  game_delete(solution);
+
+  // a game without solution must be left unchanged
+  game g2 = game_new_empty_ext(3, 3, false, FULL);
+  game_set_constraint(g2, 0, 0, 0);
+  game_set_constraint(g2, 1, 1, 9);
+  game_set_color(g2, 2, 2, WHITE);
+  game copy = game_copy(g2);
+  ok = ok && !game_solve(g2) && game_equal(g2, copy);
+  ok = ok && game_nb_solutions(g2) == 0;
+
+  // without any constraint, every coloring is a solution
+  game g3 = game_new_empty_ext(4, 4, true, ORTHO);
+  ok = ok && game_nb_solutions(g3) == (1u << 16);
+
+  game_delete(g);
+  game_delete(g2);
+  game_delete(copy);
+  game_delete(g3);
+  return ok;
+}
+
+static bool cancel_search(const game_solver_stats *stats, void *data) {
+  (*(int *)data)++;
+  return false;
+}
+
+bool test_game_solve_ext() {
+  game g = game_default();
+  game_solver_stats stats;
+  bool ok = game_solve_ext(g, &stats, NULL, NULL, 0) && game_won(g);
+  ok = ok && stats.nb_solutions == 1 && !stats.cancelled;
+  ok = ok && stats.nb_propagations + stats.nb_nodes >= 25;
+
+  ok = ok && game_nb_solutions_ext(g, &stats, NULL, NULL, 0) == 1;
+  ok = ok && stats.nb_nodes > 0 && stats.max_depth == 25;
+
+  // the callback is called after the first node and cancels the count
+  int calls = 0;
+  ok = ok && game_nb_solutions_ext(g, &stats, cancel_search, &calls, 1) == 0;
+  ok = ok && stats.cancelled && calls == 1;
+
+  game_delete(g);
+  return ok;
+}
 
-//     if (game_solve(sample_game)) {
-//         printf("Test passed: Game solved!\n");
-//     } else {
-//         printf("Test failed: Unable to solve the game.\n");
-//     }
-// }
+bool test_game_solve_pairs() {
+  rng r;
+  rng_seed(&r, 5);
+  bool ok = true;
+  uint nb_pair = 0;
+  for (int k = 0; k < 400 && ok; k++) {
+    uint nb_rows = 1 + rng_uniform(&r, 8), nb_cols = 1 + rng_uniform(&r, 8);
+    game g = game_random_r(nb_rows, nb_cols, k % 2, k % 4, false, 0.5f, 0.6f,
+                           &r);
+    if (!g) continue;
+    rating rate = game_rate(g);
+    game_solver_stats stats;
+    ok = game_solve_ext(g, &stats, NULL, NULL, 0) && game_won(g);
+    // what single clues and clue pairs deduce needs no search node
+    if (rate.level <= TIER_PAIR) ok = ok && stats.nb_nodes == 0;
+    if (rate.level == TIER_PAIR) nb_pair++;
+    game_delete(g);
+  }
+  return ok && nb_pair > 0;
+}
+
+static bool snapshot_matches(snapshot s, cgame g) {
+  for (uint i = 0; i < game_nb_rows(g); i++) {
+    for (uint j = 0; j < game_nb_cols(g); j++) {
+      if (snapshot_get_color(s, i, j) != game_get_color(g, i, j)) return false;
+    }
+  }
+  return true;
+}
+
+bool test_game_snapshot() {
+  // 50x45 squares need two levels of tree above the tiles
+  game g = game_new_empty_ext(50, 45, true, FULL);
+  snapshot s0 = game_snapshot(g);
+  snapshot s0b = game_snapshot(g);
+  bool ok = (s0 == s0b) && snapshot_matches(s0, g);  // nothing changed
+
+  game_play_move(g, 0, 0, BLACK);
+  game_play_move(g, 49, 44, WHITE);
+  snapshot s1 = game_snapshot(g);
+  ok = ok && s1 != s0 && snapshot_matches(s1, g);
+  ok = ok && snapshot_get_color(s0, 0, 0) == EMPTY;
+
+  // derived versions leave their parent unchanged
+  snapshot s2 = snapshot_set_color(s1, 10, 10, WHITE);
+  ok = ok && snapshot_get_color(s2, 10, 10) == WHITE &&
+       snapshot_get_color(s1, 10, 10) == EMPTY &&
+       snapshot_get_color(s2, 0, 0) == BLACK;
+
+  // a chain of versions, checked against a game playing the same moves
+  game expected = game_copy(g);
+  snapshot s = snapshot_ref(s1);
+  rng r;
+  rng_seed(&r, 42);
+  for (int k = 0; k < 1000; k++) {
+    uint i = rng_uniform(&r, 50), j = rng_uniform(&r, 45);
+    color c = rng_uniform(&r, 3);
+    snapshot next = snapshot_set_color(s, i, j, c);
+    snapshot_release(s);
+    s = next;
+    game_set_color(expected, i, j, c);
+  }
+  ok = ok && snapshot_matches(s, expected);
+
+  // restoring copies the differences, then snapshots follow the game again
+  game_restore_snapshot(g, s);
+  ok = ok && game_equal(g, expected);
+  game_restore_snapshot(g, s0);
+  ok = ok && snapshot_matches(s0, g) && game_get_color(g, 49, 44) == EMPTY;
+  game_set_color(g, 20, 20, BLACK);
+  game_undo(g);  // sets (49, 44) back to EMPTY
+  snapshot s3 = game_snapshot(g);
+  ok = ok && snapshot_matches(s3, g) && snapshot_get_color(s3, 20, 20) == BLACK;
+  game_restart(g);
+  snapshot s4 = game_snapshot(g);
+  ok = ok && snapshot_matches(s4, g) && snapshot_matches(s0, g);
+
+  snapshot_release(s0);
+  snapshot_release(s0b);
+  snapshot_release(s1);
+  snapshot_release(s2);
+  snapshot_release(s3);
+  snapshot_release(s4);
+  snapshot_release(s);
+  game_delete(g);
+  game_delete(expected);
+  return ok;
+}
+
+// Status of (i, j) computed from scratch, as in the first version of the game.
+static status reference_status(cgame g, uint i, uint j) {
+  bool exclude = (g->neigh == FULL_EXCLUDE || g->neigh == ORTHO_EXCLUDE);
+  bool ortho = (g->neigh == ORTHO || g->neigh == ORTHO_EXCLUDE);
+  int black = 0, empty = 0;
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      if ((exclude && x == 0 && y == 0) || (ortho && x != 0 && y != 0)) {
+        continue;
+      }
+      int ni = (int)i + x, nj = (int)j + y;
+      if (g->wrapping) {
+        ni = (ni + g->row) % g->row;
+        nj = (nj + g->column) % g->column;
+      } else if (ni < 0 || ni >= g->row || nj < 0 || nj >= g->column) {
+        continue;
+      }
+      black += (game_get_color(g, ni, nj) == BLACK);
+      empty += (game_get_color(g, ni, nj) == EMPTY);
+    }
+  }
+  constraint n = game_get_constraint(g, i, j);
+  if (n == UNCONSTRAINED) return empty == 0 ? SATISFIED : UNSATISFIED;
+  if (black > n || (black < n && empty == 0)) return ERROR;
+  return black < n ? UNSATISFIED : SATISFIED;
+}
+
+bool test_game_status_kernels() {
+  uint sizes[][2] = {{1, 1}, {1, 4}, {2, 3}, {3, 3}, {6, 9}};
+  rng r;
+  rng_seed(&r, 3);
+  for (uint k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    for (neighbourhood neigh = FULL; neigh <= ORTHO_EXCLUDE; neigh++) {
+      for (int wrapping = 0; wrapping < 2; wrapping++) {
+        game g = game_new_empty_ext(sizes[k][0], sizes[k][1], wrapping, neigh);
+        for (int round = 0; round < 20; round++) {
+          for (uint i = 0; i < g->row; i++) {
+            for (uint j = 0; j < g->column; j++) {
+              game_set_color(g, i, j, rng_uniform(&r, 3));
+              game_set_constraint(g, i, j, (int)rng_uniform(&r, 11) - 1);
+            }
+          }
+          for (uint i = 0; i < g->row; i++) {
+            for (uint j = 0; j < g->column; j++) {
+              if (game_get_status(g, i, j) != reference_status(g, i, j)) {
+                game_delete(g);
+                return false;
+              }
+            }
+          }
+        }
+        game_delete(g);
+      }
+    }
+  }
+  return true;
+}
 
 int test_dummy() { return EXIT_SUCCESS; }
 
@@ -128,6 +313,16 @@ int main(int argc, char *argv[]) {
   } else if (strcmp(nom, "test_game_delete") == 0) {
     int res = test_game_delete();
     ok = res;
+  } else if (strcmp(nom, "test_game_solve") == 0) {
+    ok = test_game_solve();
+  } else if (strcmp(nom, "test_game_solve_ext") == 0) {
+    ok = test_game_solve_ext();
+  } else if (strcmp(nom, "test_game_solve_pairs") == 0) {
+    ok = test_game_solve_pairs();
+  } else if (strcmp(nom, "test_game_snapshot") == 0) {
+    ok = test_game_snapshot();
+  } else if (strcmp(nom, "test_game_status_kernels") == 0) {
+    ok = test_game_status_kernels();
   } else {
     printf("Invalid argument or test name unknown\n");
     return EXIT_FAILURE;
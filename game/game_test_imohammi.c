@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,7 +9,8 @@
 #include "game_ext.h"
 #include "game_struct.h"
 #include "game_tools.h"
-#include "queue.h"
+#include "grid.h"
+#include "trace.h"
 
 bool test_game_set_color() {
   game g = game_default();
@@ -38,6 +40,58 @@ bool test_game_get_status() {
 
 bool test_game_nb_neighbors() { return true; }
 
+bool test_game_max_neighbors() {
+  // corner, edge and inner squares of a 4x5 grid, per neighbourhood
+  int expected[4][3] = {{4, 6, 9}, {3, 4, 5}, {3, 5, 8}, {2, 3, 4}};
+  bool result = true;
+  for (neighbourhood neigh = FULL; neigh <= ORTHO_EXCLUDE; neigh++) {
+    game g = game_new_empty_ext(4, 5, false, neigh);
+    game w = game_new_empty_ext(4, 5, true, neigh);
+    result &= (game_max_neighbors(g, 0, 0) == expected[neigh][0]);
+    result &= (game_max_neighbors(g, 0, 2) == expected[neigh][1]);
+    result &= (game_max_neighbors(g, 2, 2) == expected[neigh][2]);
+    result &= (game_max_neighbors(w, 0, 0) == expected[neigh][2]);
+    game_set_color(w, 3, 4, BLACK);
+    result &= (game_nb_neighbors(w, 0, 0, BLACK) == (neigh % 2 == 0));
+    result &= (game_nb_neighbors(g, 0, 0, BLACK) == 0);
+
+    // games of the same shape share their table
+    game copy = game_copy(g);
+    game same = game_new_empty_ext(4, 5, false, neigh);
+    result &= (copy->neighbors == g->neighbors);
+    result &= (same->neighbors == g->neighbors);
+    result &= (w->neighbors != g->neighbors);
+    game_delete(g);
+    game_delete(same);
+    result &= (game_max_neighbors(copy, 1, 1) == expected[neigh][2]);
+    const neighbor_table *table = copy->neighbors;
+    game_delete(copy);
+    game_delete(w);
+
+    // an unused table stays cached for the next game of its shape
+    game next = game_new_empty_ext(4, 5, false, neigh);
+    result &= (next->neighbors == table);
+    game_delete(next);
+  }
+
+  // tiny wrapping grids reach the same square several times
+  game g = game_new_empty_ext(1, 2, true, FULL);
+  game_set_color(g, 0, 1, BLACK);
+  result &= (game_max_neighbors(g, 0, 0) == 9);
+  result &= (game_nb_neighbors(g, 0, 0, BLACK) == 6);
+
+  // diagonal moves
+  uint i, j;
+  result &= game_get_next_square(g, 0, 0, UP_LEFT, &i, &j) && i == 0 && j == 1;
+  game_delete(g);
+  g = game_new_empty_ext(3, 3, false, FULL);
+  result &= game_get_next_square(g, 1, 1, DOWN_RIGHT, &i, &j) && i == 2 &&
+            j == 2;
+  result &= !game_get_next_square(g, 0, 1, UP_RIGHT, &i, &j);
+  game_delete(g);
+  return result;
+}
+
 bool test_game_play_move() {
   bool result = true;
   game g = game_default();  // Initialize the game
@@ -112,8 +166,13 @@ bool test_game_new_ext() {
     game_delete(g);
     return false;
   }
-
   game_delete(g);
+
+  // an unknown neighbourhood is refused instead of indexing the kernels
+  g = game_new_ext(rows, cols, constraints, colors, false, ORTHO_EXCLUDE + 1);
+  if (g != NULL || game_new_empty_ext(rows, cols, false, 7) != NULL) {
+    return false;
+  }
   return true;
 }
 
@@ -212,6 +271,108 @@ bool test_game_redo() {
 
   return result;
 }
+// plays nb_moves random moves (with some undos) on a 5x5 game and records the
+// colors after each position of the history in boards
+static game play_random_moves(uint nb_moves, color *boards) {
+  game g = game_new_empty_ext(5, 5, false, FULL);
+  rng r;
+  rng_seed(&r, 41);
+  memcpy(boards, g->colors, 25 * sizeof(color));
+  for (uint k = 0; k < nb_moves; k++) {
+    game_play_move(g, rng_uniform(&r, 5), rng_uniform(&r, 5),
+                   rng_uniform(&r, 3));
+    memcpy(boards + 25 * (k + 1), g->colors, 25 * sizeof(color));
+  }
+  return g;
+}
+
+bool test_game_goto() {
+  uint nb_moves = 2000;  // several snapshot periods
+  color *boards = malloc((nb_moves + 1) * 25 * sizeof(color));
+  game g = play_random_moves(nb_moves, boards);
+  bool ok = game_nb_moves(g) == nb_moves && game_current_move(g) == nb_moves;
+
+  size_t targets[] = {0, 1999, 256, 255, 257, 1024, 3, 2000, 700, 512, 0};
+  for (uint k = 0; k < sizeof(targets) / sizeof(targets[0]); k++) {
+    game_goto(g, targets[k]);
+    ok = ok && game_current_move(g) == targets[k] &&
+         memcmp(g->colors, boards + 25 * targets[k], 25 * sizeof(color)) == 0;
+  }
+
+  // undo and redo continue from the new position, out of range does nothing
+  game_goto(g, 700);
+  game_undo(g);
+  ok = ok && memcmp(g->colors, boards + 25 * 699, 25 * sizeof(color)) == 0;
+  game_redo(g);
+  game_redo(g);
+  ok = ok && memcmp(g->colors, boards + 25 * 701, 25 * sizeof(color)) == 0;
+  game_goto(g, nb_moves + 1);
+  ok = ok && game_current_move(g) == 701;
+
+  // a new move drops the end of the history
+  game_play_move(g, 0, 0, BLACK);
+  ok = ok && game_nb_moves(g) == 702 && game_current_move(g) == 702;
+  game_goto(g, 300);
+  ok = ok && memcmp(g->colors, boards + 25 * 300, 25 * sizeof(color)) == 0;
+  game_goto(g, 702);
+  ok = ok && game_get_color(g, 0, 0) == BLACK;
+
+  game_restart(g);
+  ok = ok && game_nb_moves(g) == 0 && game_current_move(g) == 0;
+  game_goto(g, 0);
+  ok = ok && game_get_color(g, 0, 0) == EMPTY;
+  game_delete(g);
+  free(boards);
+
+  // colors changed outside the history are kept, as undo and redo keep them
+  game g2 = game_default();
+  for (uint k = 0; k < 300; k++) game_play_move(g2, 0, 0, 1 + k % 2);
+  game_set_color(g2, 4, 4, BLACK);
+  size_t targets2[] = {260, 10, 0, 300};
+  for (uint k = 0; k < sizeof(targets2) / sizeof(targets2[0]); k++) {
+    game expected = game_copy(g2);
+    for (size_t m = 300; m > targets2[k]; m--) game_undo(g2);
+    for (uint i = 0; i < game_nb_rows(g2); i++) {
+      for (uint j = 0; j < game_nb_cols(g2); j++) {
+        game_set_color(expected, i, j, game_get_color(g2, i, j));
+      }
+    }
+    for (size_t m = targets2[k]; m < 300; m++) game_redo(g2);
+    game_goto(g2, targets2[k]);
+    ok = ok && game_equal(g2, expected) && game_get_color(g2, 4, 4) == BLACK;
+    game_goto(g2, 300);
+    game_delete(expected);
+  }
+  game_delete(g2);
+  return ok;
+}
+
+bool test_game_journal() {
+  uint nb_moves = 600;
+  color *boards = malloc((nb_moves + 1) * 25 * sizeof(color));
+  game g = play_random_moves(nb_moves, boards);
+  game_goto(g, 450);
+  if (!game_save_journal(g, "journal_test.txt")) return false;
+
+  // a journal is also a plain game file, at the saved position
+  game g2 = game_load("journal_test.txt");
+  game g3 = game_load_journal("journal_test.txt");
+  bool ok = g2 && g3 && game_equal(g, g2) && game_equal(g, g3) &&
+            game_nb_moves(g3) == nb_moves && game_current_move(g3) == 450;
+  if (ok) {
+    game_goto(g3, 0);
+    ok = memcmp(g3->colors, boards, 25 * sizeof(color)) == 0;
+    game_goto(g3, nb_moves);
+    ok = ok && memcmp(g3->colors, boards + 25 * nb_moves,
+                      25 * sizeof(color)) == 0;
+  }
+  game_delete(g);
+  game_delete(g2);
+  game_delete(g3);
+  free(boards);
+  return ok && game_load_journal("missing_journal.txt") == NULL;
+}
+
 bool test_game_load() {
   // Create a new game and save it to a file
   game g = game_new_empty_ext(7, 6, false, FULL);
@@ -234,6 +395,163 @@ bool test_game_load() {
   }
 }
 
+bool test_game_random_r() {
+  // the same seed must give the same game, a jumped stream another one
+  rng r1, r2;
+  rng_seed(&r1, 2024);
+  rng_seed(&r2, 2024);
+  game g1 = game_random_r(6, 7, true, ORTHO, true, 0.5f, 0.5f, &r1);
+  game g2 = game_random_r(6, 7, true, ORTHO, true, 0.5f, 0.5f, &r2);
+  if (g1 == NULL || g2 == NULL || !game_equal(g1, g2) || !game_won(g1)) {
+    return false;
+  }
+
+  rng_seed(&r2, 2024);
+  rng_jump(&r2);
+  game g3 = game_random_r(6, 7, true, ORTHO, true, 0.5f, 0.5f, &r2);
+  bool ok = (g3 != NULL && !game_equal(g1, g3));
+
+  for (int k = 0; k < 1000; k++) {
+    float x = rng_float(&r1);
+    if (x < 0.0f || x >= 1.0f || rng_uniform(&r1, 7) >= 7) ok = false;
+  }
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  return ok;
+}
+
+bool test_game_rate() {
+  // the default game is solved by single clues only
+  game g = game_default();
+  rating r = game_rate(g);
+  bool ok = (r.level == TIER_SINGLE && r.nb_single == 25 && r.nb_unknown == 0);
+  ok = ok && game_get_color(g, 0, 0) == EMPTY;  // g is left unchanged
+  game_delete(g);
+
+  // two adjacent clues 0 and 9 cannot both hold
+  game g2 = game_new_empty_ext(3, 3, false, FULL);
+  game_set_constraint(g2, 1, 1, 9);
+  game_set_constraint(g2, 0, 0, 0);
+  ok = ok && game_rate(g2).level == TIER_INVALID;
+
+  // without any clue, every square is free
+  game_set_constraint(g2, 1, 1, UNCONSTRAINED);
+  game_set_constraint(g2, 0, 0, UNCONSTRAINED);
+  r = game_rate(g2);
+  ok = ok && r.level == TIER_NONE && r.nb_free == 9;
+  game_delete(g2);
+  return ok;
+}
+
+typedef struct {
+  game g;
+  bool ok;
+  uint8_t *seen;  // the solutions listed so far, one after the other
+  uint64_t nb;
+} listing;
+
+static bool collect_solution(const uint8_t *bits, void *data) {
+  listing *l = data;
+  size_t size = game_packed_size(l->g);
+  game_unpack(l->g, bits);
+  l->ok = l->ok && game_won(l->g);
+  for (uint64_t k = 0; k < l->nb; k++) {
+    if (memcmp(l->seen + k * size, bits, size) == 0) l->ok = false;
+  }
+  l->seen = realloc(l->seen, (l->nb + 1) * size);
+  memcpy(l->seen + l->nb++ * size, bits, size);
+  return true;
+}
+
+static bool stop_solution(const uint8_t *bits, void *data) {
+  (*(int *)data)++;
+  return false;
+}
+
+bool test_game_for_each_solution() {
+  rng r;
+  rng_seed(&r, 9);
+  bool ok = true;
+  for (int k = 0; k < 200 && ok; k++) {
+    uint nb_rows = 1 + rng_uniform(&r, 4), nb_cols = 1 + rng_uniform(&r, 5);
+    game g = game_random_r(nb_rows, nb_cols, k % 2, k % 4, false, 0.5f, 0.4f,
+                           &r);
+    if (!g) continue;
+    listing l = {game_copy(g), true, NULL, 0};
+    uint64_t nb = game_for_each_solution(g, collect_solution, &l, 0);
+    ok = l.ok && nb == l.nb && nb == game_nb_solutions(g);
+
+    // the iterator lists the same solutions in the same order
+    size_t size = game_packed_size(g);
+    game_solutions it = game_solutions_new(g);
+    const uint8_t *bits;
+    uint64_t i = 0;
+    while (ok && (bits = game_solutions_next(it))) {
+      ok = i < nb && memcmp(bits, l.seen + i++ * size, size) == 0;
+    }
+    ok = ok && i == nb && game_solutions_next(it) == NULL;
+    game_solutions_delete(it);
+
+    if (nb > 1) {
+      l.nb = 0;
+      ok = ok && game_for_each_solution(g, collect_solution, &l, 1) == 1;
+    }
+    free(l.seen);
+    game_delete(l.g);
+    game_delete(g);
+  }
+
+  // without any clue, every coloring is listed; the callback may stop early
+  game g = game_new_empty_ext(3, 4, true, ORTHO);
+  listing l = {game_copy(g), true, NULL, 0};
+  ok = ok && game_for_each_solution(g, collect_solution, &l, 0) == 1u << 12;
+  ok = ok && l.ok;
+  int calls = 0;
+  ok = ok && game_for_each_solution(g, stop_solution, &calls, 0) == 1;
+  ok = ok && calls == 1;
+  free(l.seen);
+  game_delete(l.g);
+  game_delete(g);
+  return ok;
+}
+
+static void *trace_worker(void *arg) {
+  TRACE_SCOPE("worker");
+  return arg;
+}
+
+bool test_trace() {
+  // nothing is recorded before tracing is enabled
+  TRACE_BEGIN("ignored");
+  TRACE_END("ignored");
+  trace_init("trace_test.json");
+  if (!trace_enabled) return false;
+  game g = game_default();
+  game_solve(g);
+  game_delete(g);
+  // threads started one after the other share a single buffer, and tid
+  for (int k = 0; k < 3; k++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, trace_worker, NULL) != 0) return false;
+    pthread_join(thread, NULL);
+  }
+  trace_flush();
+
+  FILE *f = fopen("trace_test.json", "r");
+  if (!f) return false;
+  char buffer[4096];
+  size_t len = fread(buffer, 1, sizeof(buffer) - 1, f);
+  buffer[len] = '\0';
+  fclose(f);
+  return strstr(buffer, "\"traceEvents\"") &&
+         strstr(buffer, "\"name\": \"game_solve\", \"ph\": \"B\"") &&
+         strstr(buffer, "\"name\": \"game_solve\", \"ph\": \"E\"") &&
+         strstr(buffer, "\"tid\": 1") && !strstr(buffer, "\"tid\": 2") &&
+         !strstr(buffer, "ignored");
+}
+
 int test_dummy() { return EXIT_SUCCESS; }
 
 int main(int argc, char *argv[]) {
@@ -255,6 +573,9 @@ int main(int argc, char *argv[]) {
   } else if (strcmp(nom, "test_game_nb_neighbors") == 0) {
     ok = test_game_nb_neighbors();
 
+  } else if (strcmp(nom, "test_game_max_neighbors") == 0) {
+    ok = test_game_max_neighbors();
+
   } else if (strcmp(nom, "test_game_play_move") == 0) {
     ok = test_game_play_move();
 
@@ -288,8 +609,25 @@ int main(int argc, char *argv[]) {
   } else if (strcmp(nom, "test_game_redo") == 0) {
     ok = test_game_redo();
 
+  } else if (strcmp(nom, "test_game_goto") == 0) {
+    ok = test_game_goto();
+
+  } else if (strcmp(nom, "test_game_journal") == 0) {
+    ok = test_game_journal();
+
   } else if (strcmp(nom, "test_game_load") == 0) {
     ok = test_game_load();
+
+  } else if (strcmp(nom, "test_game_random_r") == 0) {
+    ok = test_game_random_r();
+
+  } else if (strcmp(nom, "test_game_rate") == 0) {
+    ok = test_game_rate();
+  } else if (strcmp(nom, "test_game_for_each_solution") == 0) {
+    ok = test_game_for_each_solution();
+
+  } else if (strcmp(nom, "test_trace") == 0) {
+    ok = test_trace();
   } else {
     printf("Invalid argument or test name unknown\n");
     return EXIT_FAILURE;
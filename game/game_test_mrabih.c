@@ -7,6 +7,8 @@
 #include "game_aux.h"
 #include "game_struct.h"
 #include "game_tools.h"
+#include "grid.h"
+#include "rng.h"
 
 // game_aux.h testing functions
 
@@ -124,6 +126,88 @@ int test_game_save() {
   return 0;
 }
 
+int test_game_check_solutions() {
+  uint sizes[][2] = {{1, 1}, {1, 3}, {2, 2}, {5, 5}, {7, 17}, {3, 40}, {9, 70}};
+  rng r;
+  rng_seed(&r, 7);
+  for (uint k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    for (neighbourhood neigh = FULL; neigh <= ORTHO_EXCLUDE; neigh++) {
+      for (int wrapping = 0; wrapping < 2; wrapping++) {
+        game g = game_random_r(sizes[k][0], sizes[k][1], wrapping, neigh, true,
+                               0.5f, 0.7f, &r);
+        assert(g);
+        size_t size = game_packed_size(g), n = 64;
+        uint nb_squares = sizes[k][0] * sizes[k][1];
+        uint8_t *candidates = malloc(n * size);
+        bool expected[64], ok[64];
+        game_pack(g, candidates);
+        expected[0] = true;
+        for (size_t c = 1; c < n; c++) {
+          // the solution with a few squares flipped, judged by game_won
+          uint8_t *bits = candidates + c * size;
+          memcpy(bits, candidates, size);
+          for (uint f = rng_uniform(&r, 3); f > 0; f--) {
+            uint s = rng_uniform(&r, nb_squares);
+            bits[s / 8] ^= 1 << (s % 8);
+          }
+          game h = game_copy(g);
+          game_unpack(h, bits);
+          expected[c] = game_won(h);
+          uint8_t *repacked = malloc(size);
+          game_pack(h, repacked);
+          assert(memcmp(repacked, bits, size) == 0);
+          free(repacked);
+          game_delete(h);
+        }
+        game_restart(g);  // the colors of the puzzle are ignored
+        size_t nb_ok = 0;
+        for (size_t c = 0; c < n; c++) nb_ok += expected[c];
+        bool same = game_check_solutions(g, candidates, n, ok) == nb_ok;
+        for (size_t c = 0; c < n; c++) same = same && ok[c] == expected[c];
+        free(candidates);
+        game_delete(g);
+        if (!same) return EXIT_FAILURE;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int test_game_status_grid() {
+  uint sizes[][2] = {{1, 1}, {1, 2}, {2, 1}, {2, 3}, {5, 5}, {6, 17}, {4, 70}};
+  rng r;
+  rng_seed(&r, 11);
+  for (uint k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    for (neighbourhood neigh = FULL; neigh <= ORTHO_EXCLUDE; neigh++) {
+      for (int wrapping = 0; wrapping < 2; wrapping++) {
+        game g = game_random_r(sizes[k][0], sizes[k][1], wrapping, neigh, true,
+                               0.5f, 0.6f, &r);
+        assert(g);
+        uint nb_squares = sizes[k][0] * sizes[k][1];
+        status *out = malloc(nb_squares * sizeof(status));
+        for (int round = 0; round < 4; round++) {
+          // the solution, then colorings with more and more empty squares
+          game_status_grid(g, out);
+          for (uint i = 0; i < sizes[k][0]; i++) {
+            for (uint j = 0; j < sizes[k][1]; j++) {
+              assert(out[i * sizes[k][1] + j] == game_get_status(g, i, j));
+            }
+          }
+          for (uint s = 0; s < nb_squares; s++) {
+            if (rng_uniform(&r, 4) == 0) continue;
+            color c = 1 + rng_uniform(&r, 2);
+            if (rng_uniform(&r, round + 1) == 0) c = EMPTY;
+            game_set_color(g, s / sizes[k][1], s % sizes[k][1], c);
+          }
+        }
+        free(out);
+        game_delete(g);
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
 int test_dummy() { return EXIT_SUCCESS; }
 
 int main(int argc, char *argv[]) {
@@ -166,6 +250,12 @@ int main(int argc, char *argv[]) {
   } else if (strcmp(nom, "test_game_save") == 0) {
     res = test_game_save();
     ok = (res == EXIT_SUCCESS);
+  } else if (strcmp(nom, "test_game_check_solutions") == 0) {
+    res = test_game_check_solutions();
+    ok = (res == EXIT_SUCCESS);
+  } else if (strcmp(nom, "test_game_status_grid") == 0) {
+    res = test_game_status_grid();
+    ok = (res == EXIT_SUCCESS);
   } else {
     printf("Invalid argument or test name unknown\n");
     return EXIT_FAILURE;
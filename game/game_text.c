@@ -1,14 +1,140 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
 #include "game_tools.h"
+#include "grid.h"
+#include "trace.h"
+
+/* ******************** replay ******************** */
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_status(cgame g) {
+  uint nb_empty = 0, nb_errors = 0;
+  status *statuses = malloc(game_nb_rows(g) * game_nb_cols(g) * sizeof(status));
+  game_status_grid(g, statuses);
+  for (uint i = 0; i < game_nb_rows(g); i++) {
+    for (uint j = 0; j < game_nb_cols(g); j++) {
+      if (game_get_color(g, i, j) == EMPTY) nb_empty++;
+      if (statuses[i * game_nb_cols(g) + j] == ERROR) nb_errors++;
+    }
+  }
+  free(statuses);
+  printf("%s, %u empty, %u errors\n", game_won(g) ? "won" : "not won",
+         nb_empty, nb_errors);
+}
+
+// Applies the commands of the text interface read from file ("w|b|e <i> <j>",
+// "z", "y", "g <n>", "r" and "q", one per line, '#' starts a comment) without
+// printing the board, then reports the final status and the command rate. If
+// checkpoint is not 0, the status is also printed every checkpoint commands.
+// Returns false on a malformed line or a square out of the grid.
+static bool replay(game g, FILE *file, unsigned long checkpoint) {
+  char line[256];
+  unsigned long nb_lines = 0, nb_commands = 0;
+  bool ok = true;
+  TRACE_BEGIN("replay");
+  double start = now();
+  while (fgets(line, sizeof(line), file)) {
+    nb_lines++;
+    char *c = line;
+    while (*c == ' ' || *c == '\t') c++;
+    if (*c == '\0' || *c == '\n' || *c == '#') continue;
+    char command = *c++;
+    if (command == 'w' || command == 'b' || command == 'e') {
+      char *end;
+      long i = strtol(c, &end, 10);
+      long j = strtol(end, &c, 10);
+      if (c == end || i < 0 || i >= game_nb_rows(g) || j < 0 ||
+          j >= game_nb_cols(g)) {
+        fprintf(stderr, "line %lu: invalid move\n", nb_lines);
+        ok = false;
+        break;
+      }
+      color col = command == 'w' ? WHITE : command == 'b' ? BLACK : EMPTY;
+      game_play_move(g, i, j, col);
+    } else if (command == 'z') {
+      game_undo(g);
+    } else if (command == 'y') {
+      game_redo(g);
+    } else if (command == 'g') {
+      char *end;
+      unsigned long n = strtoul(c, &end, 10);
+      if (end == c || n > game_nb_moves(g)) {
+        fprintf(stderr, "line %lu: invalid position\n", nb_lines);
+        ok = false;
+        break;
+      }
+      game_goto(g, n);
+    } else if (command == 'r') {
+      game_restart(g);
+    } else if (command == 'q') {
+      break;
+    } else {
+      fprintf(stderr, "line %lu: unknown command '%c'\n", nb_lines, command);
+      ok = false;
+      break;
+    }
+    nb_commands++;
+    if (checkpoint && nb_commands % checkpoint == 0) {
+      printf("checkpoint %lu: ", nb_commands);
+      print_status(g);
+    }
+  }
+  double elapsed = now() - start;
+  TRACE_END("replay");
+  printf("%lu commands in %.3f s (%.0f commands/s)\n", nb_commands, elapsed,
+         elapsed > 0 ? nb_commands / elapsed : 0.0);
+  print_status(g);
+  return ok;
+}
+
+/* ******************** main ******************** */
+
+static void usage(char *name) {
+  fprintf(stderr,
+          "Usage: %s [--trace <file>] [--replay <moves> | --batch] "
+          "[--checkpoint <n>] [<game file>]\n",
+          name);
+  exit(EXIT_FAILURE);
+}
 
 int main(int argc, char *argv[]) {
   game g;
+  trace_parse_args(&argc, argv);
+
+  // --replay FILE or --batch (commands from stdin) skip the interactive loop
+  char *replay_file = NULL;
+  bool batch = false;
+  unsigned long checkpoint = 0;
+  int nb_args = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_file = argv[++i];
+      batch = true;
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+      checkpoint = strtoul(argv[++i], NULL, 10);
+    } else if (strncmp(argv[i], "--", 2) == 0) {
+      usage(argv[0]);
+    } else {
+      argv[nb_args++] = argv[i];
+    }
+  }
+  argc = nb_args;
 
   if (argc > 1) {
     g = game_load(argv[1]);
@@ -20,16 +146,32 @@ int main(int argc, char *argv[]) {
     g = game_default();
   }
 
+  if (batch) {
+    FILE *file = replay_file ? fopen(replay_file, "r") : stdin;
+    if (!file) {
+      fprintf(stderr, "Failed to open move file: %s\n", replay_file);
+      exit(EXIT_FAILURE);
+    }
+    bool ok = replay(g, file, checkpoint);
+    if (file != stdin) fclose(file);
+    game_delete(g);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   while (!(game_won(g))) {
     game_print(g);
+    status *statuses =
+        malloc(game_nb_rows(g) * game_nb_cols(g) * sizeof(status));
+    game_status_grid(g, statuses);
     for (int i = 0; i < game_nb_rows(g); i++) {
       for (int j = 0; j < game_nb_cols(g); j++) {
-        status myStatus = game_get_status(g, i, j);
+        status myStatus = statuses[i * game_nb_cols(g) + j];
         if (game_get_constraint(g, i, j) != -1 && myStatus == ERROR) {
           printf("errors:%d \n", game_get_constraint(g, i, j));
         }
       }
     }
+    free(statuses);
     printf("Type a command ([h] for help, [s <filename>] to save): \n");
 
     char command[256];
@@ -57,6 +199,7 @@ int main(int argc, char *argv[]) {
       printf("- press 'e <i> <j> ' to set square (i,j) empty\n");
       printf("- press 'z' to undo\n");
       printf("- press 'y' to redo\n");
+      printf("- press 'g <n>' to go to move n of the history\n");
       printf("- press 'r' to restart\n");
       printf("- press 'q' to quit\n");
     } else if (command[0] == 'r') {
@@ -65,6 +208,13 @@ int main(int argc, char *argv[]) {
       game_undo(g);
     } else if (command[0] == 'y') {
       game_redo(g);
+    } else if (command[0] == 'g') {
+      unsigned long n;
+      if (scanf("%lu", &n) != 1) {
+        fprintf(stderr, "Failed to read the move number\n");
+        continue;
+      }
+      game_goto(g, n);
     } else if (command[0] == 'w' || command[0] == 'b' || command[0] == 'e') {
       int i, j;
       // Check if scanf successfully reads the input row and column indices
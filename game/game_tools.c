@@ -1,32 +1,63 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "game_tools.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "game.h"
 #include "game_aux.h"
 #include "game_struct.h"
+#include "trace.h"
 
 game game_load(char *filename) {
+  TRACE_SCOPE("game_load");
   FILE *file = fopen(filename, "r");
   if (!file) {
     fprintf(stderr, "Cannot open file %s\n", filename);
     return NULL;
   }
 
+  game g = game_load_file(file);
+  fclose(file);
+  return g;
+}
+
+game game_load_file(FILE *file) {
   int nb_rows, nb_cols, wrapping, neigh;
   if (fscanf(file, "%d %d %d %d\n", &nb_rows, &nb_cols, &wrapping, &neigh) !=
       4) {
-    fprintf(stderr, "Failed to read the game configuration properly.\n");
-    fclose(file);
+    if (!feof(file)) {
+      fprintf(stderr, "Failed to read the game configuration properly.\n");
+    }
+    return NULL;
+  }
+  if (nb_rows <= 0 || nb_cols <= 0 ||
+      (uint64_t)nb_rows * nb_cols > GAME_MAX_SQUARES) {
+    fprintf(stderr, "Invalid game size: %d x %d\n", nb_rows, nb_cols);
+    return NULL;
+  }
+  if (wrapping != 0 && wrapping != 1) {
+    fprintf(stderr, "Invalid wrapping option: %d\n", wrapping);
+    return NULL;
+  }
+  if (neigh < FULL || neigh > ORTHO_EXCLUDE) {
+    fprintf(stderr, "Invalid neighbourhood: %d\n", neigh);
     return NULL;
   }
 
   constraint *constraints = malloc(nb_rows * nb_cols * sizeof(constraint));
   color *colors = malloc(nb_rows * nb_cols * sizeof(color));
+  if (!constraints || !colors) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    exit(EXIT_FAILURE);
+  }
 
   for (int i = 0; i < nb_rows; i++) {
     for (int j = 0; j < nb_cols; j++) {
@@ -37,7 +68,6 @@ game game_load(char *filename) {
       if (constraint_char == EOF) {
         fprintf(stderr, "Error reading from file\n");
         // Handle the error appropriately, e.g., return NULL
-        fclose(file);
         free(constraints);
         free(colors);
         return NULL;
@@ -47,12 +77,19 @@ game game_load(char *filename) {
       if (fscanf(file, " %c", &color_char) != 1) {
         fprintf(stderr, "Error reading color character\n");
         // Handle the error appropriately, e.g., return NULL
-        fclose(file);
         free(constraints);
         free(colors);
         return NULL;
       }
 
+      if (constraint_char != '-' &&
+          (constraint_char < '0' || constraint_char > '9')) {
+        fprintf(stderr, "Unexpected constraint character: %c\n",
+                constraint_char);
+        free(constraints);
+        free(colors);
+        return NULL;
+      }
       constraints[i * nb_cols + j] =
           (constraint_char == '-') ? UNCONSTRAINED : constraint_char - '0';
       switch (color_char) {
@@ -67,15 +104,14 @@ game game_load(char *filename) {
           break;
         default:
           fprintf(stderr, "Unexpected color character: %c\n", color_char);
-          // Handle unexpected character appropriately
-          break;
+          free(constraints);
+          free(colors);
+          return NULL;
       }
     }
     fgetc(file);  // To read the newline character
   }
 
-  fclose(file);
-
   game g = game_new_ext(nb_rows, nb_cols, constraints, colors, wrapping,
                         (neighbourhood)neigh);
   free(constraints);
@@ -91,6 +127,11 @@ void game_save(cgame g, char *filename) {
     return;
   }
 
+  game_save_file(g, file);
+  fclose(file);
+}
+
+void game_save_file(cgame g, FILE *file) {
   fprintf(file, "%d %d %d %d\n", game_nb_rows(g), game_nb_cols(g),
           game_is_wrapping(g), game_get_neighbourhood(g));
 
@@ -115,109 +156,114 @@ void game_save(cgame g, char *filename) {
     }
     fprintf(file, "\n");
   }
-
-  fclose(file);
 }
 
-bool set_and_check_game(game g, const char *word) {
-  int nb_rows = game_nb_rows(g);
-  int nb_cols = game_nb_cols(g);
-  int total_cells = nb_rows * nb_cols;
+static const char COLOR_CHARS[] = {'e', 'w', 'b'};
 
-  for (int i = 0; i < total_cells; ++i) {
-    if (g->constraints[i] != 0 || word[i] != '1') {
-      int row = i / nb_cols;
-      int col = i % nb_cols;
-      color c = (word[i] == '1') ? BLACK : WHITE;
-      game_set_color(g, row, col, c);
-    }
-  }
-
-  return game_won(g);
-}
-
-bool game_check_no_solution(cgame g) {
-  for (uint i = 0; i < game_nb_rows(g); ++i) {
-    for (uint j = 0; j < game_nb_cols(g); ++j) {
-      if (game_get_constraint(g, i, j) != UNCONSTRAINED &&
-          game_get_color(g, i, j) == EMPTY) {
-        return true;
-      }
+static bool char_to_color(char c, color *col) {
+  for (color k = EMPTY; k <= BLACK; k++) {
+    if (COLOR_CHARS[k] == c) {
+      *col = k;
+      return true;
     }
   }
   return false;
 }
 
-bool game_solve(game g) {
-  int total_cells = game_nb_rows(g) * game_nb_cols(g);
-  unsigned int max_number = 1 << total_cells;  // 2^total_cells
-  char binary_word[total_cells + 1];
-
-  // Check if the game  and has no solution
-  if (game_nb_solutions(g) == 0) {
-    return false;  // No solution for the game
-  } else {
-    for (unsigned int i = 0; i < max_number; ++i) {
-      for (int j = 0; j < total_cells; ++j) {
-        binary_word[j] = (i & (1 << j)) ? '1' : '0';
-      }
-      binary_word[total_cells] = '\0';  // Null-terminate the string
+bool game_save_journal(cgame g, char *filename) {
+  FILE *file = fopen(filename, "w");
+  if (!file) {
+    fprintf(stderr, "Cannot open file %s for writing\n", filename);
+    return false;
+  }
 
-      if (set_and_check_game(g, binary_word)) {
-        return true;  // Found a winning configuration
-      }
-    }
+  game_save_file(g, file);
+  fprintf(file, "%zu %zu\n", g->history_size, g->current_move);
+  for (size_t k = 0; k < g->history_size; k++) {
+    const move_t *move = &g->history[k];
+    fprintf(file, "%u %u %c %c\n", move->i, move->j,
+            COLOR_CHARS[move->previous_color],
+            COLOR_CHARS[move->applied_color]);
   }
-  return false;
+  bool ok = !ferror(file);
+  ok = (fclose(file) == 0) && ok;
+  return ok;
 }
 
-uint game_nb_solutions_helper(game g, uint start_row, uint start_col) {
-  uint count = 0;
-  if (game_won(g)) return 1;
-
-  for (uint i = start_row; i < game_nb_rows(g); i++) {
-    for (uint j = (i == start_row ? start_col : 0); j < game_nb_cols(g); j++) {
-      if (game_get_color(g, i, j) == EMPTY) {
-        game_set_color(g, i, j, BLACK);
-        count += game_nb_solutions_helper(g, i, j);
-        game_set_color(g, i, j, EMPTY);
-      }
-    }
+game game_load_journal(char *filename) {
+  TRACE_SCOPE("game_load_journal");
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open file %s\n", filename);
+    return NULL;
   }
-  return count;
-}
 
-uint game_nb_solutions(cgame g) {
-  game g2 = game_copy(g);
-  uint counter = 0;
-  int total_cells = game_nb_rows(g2) * game_nb_cols(g2);
-  unsigned int max_number = 1 << total_cells;  // 2^total_cells
-  char binary_word[total_cells + 1];
+  game g = game_load_file(file);
+  size_t nb_moves, position;
+  if (!g || fscanf(file, "%zu %zu", &nb_moves, &position) != 2 ||
+      position > nb_moves) {
+    fprintf(stderr, "Invalid journal %s\n", filename);
+    game_delete(g);
+    fclose(file);
+    return NULL;
+  }
 
-  for (unsigned int i = 0; i < max_number; ++i) {
-    for (int j = 0; j < total_cells; ++j) {
-      binary_word[j] = (i & (1 << j)) ? '1' : '0';
-    }
-    binary_word[total_cells] = '\0';  // Null-terminate the string
+  move_t *moves = malloc(nb_moves * sizeof(move_t));
+  bool ok = moves || nb_moves == 0;
+  for (size_t k = 0; ok && k < nb_moves; k++) {
+    char previous, applied;
+    ok = fscanf(file, "%u %u %c %c", &moves[k].i, &moves[k].j, &previous,
+                &applied) == 4 &&
+         moves[k].i < g->row && moves[k].j < g->column &&
+         char_to_color(previous, &moves[k].previous_color) &&
+         char_to_color(applied, &moves[k].applied_color);
+  }
+  fclose(file);
 
-    if (set_and_check_game(g2, binary_word)) {
-      counter++;  // Found a winning configuration
-    }
+  // The saved colors are those at the saved position: rewind them to the start
+  // of the history, then play every move again to rebuild the journal and its
+  // snapshots, checking that the moves are consistent with the board.
+  for (size_t k = position; ok && k > 0; k--) {
+    game_set_color(g, moves[k - 1].i, moves[k - 1].j,
+                   moves[k - 1].previous_color);
   }
-  return counter;
+  for (size_t k = 0; ok && k < nb_moves; k++) {
+    ok = game_get_color(g, moves[k].i, moves[k].j) == moves[k].previous_color;
+    if (ok) game_play_move(g, moves[k].i, moves[k].j, moves[k].applied_color);
+  }
+  free(moves);
+  if (!ok) {
+    fprintf(stderr, "Invalid journal %s\n", filename);
+    game_delete(g);
+    return NULL;
+  }
+  game_goto(g, position);
+  return g;
 }
 
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
                  bool with_solution, float black_rate, float constraint_rate) {
+  // keep honouring srand() for the callers of the historical interface
+  rng r;
+  rng_seed(&r, rand());
+  return game_random_r(nb_rows, nb_cols, wrapping, neigh, with_solution,
+                       black_rate, constraint_rate, &r);
+}
+
+game game_random_r(uint nb_rows, uint nb_cols, bool wrapping,
+                   neighbourhood neigh, bool with_solution, float black_rate,
+                   float constraint_rate, rng *state) {
+  TRACE_SCOPE("game_random");
   assert(black_rate >= 0.0f && black_rate <= 1.0f);
   assert(constraint_rate >= 0.0f && constraint_rate <= 1.0f);
+  assert(state);
   game g = game_new_empty_ext(nb_rows, nb_cols, wrapping, neigh);
   assert(g);
 
   // fill the grid with random colors
   for (uint i = 0; i < nb_rows; i++) {
     for (uint j = 0; j < nb_cols; j++) {
-      color c = (rand() < black_rate * (float)RAND_MAX) ? BLACK : WHITE;
+      color c = (rng_float(state) < black_rate) ? BLACK : WHITE;
       game_set_color(g, i, j, c);
     }
   }
@@ -226,18 +272,1110 @@ game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
   uint nb_squares = nb_rows * nb_cols;
   uint nb_constraints = constraint_rate * nb_squares;
   for (uint i = 0; i < nb_constraints; i++) {
-    uint row = rand() % nb_rows;
-    uint col = rand() % nb_cols;
+    uint row = rng_uniform(state, nb_rows);
+    uint col = rng_uniform(state, nb_cols);
     int nb_blacks = game_nb_neighbors(g, row, col, BLACK);
     game_set_constraint(g, row, col, nb_blacks);
   }
 
   // check solution
-  if (!game_won(g)) {
+  TRACE_BEGIN("verify");
+  bool valid = game_won(g);
+  TRACE_END("verify");
+  if (!valid) {
     game_delete(g);
     return NULL;
   }
 
   if (!with_solution) game_restart(g);
   return g;
-}
\ No newline at end of file
+}
+
+/* ******************** logical deduction ******************** */
+
+// Clue windows of a game, stored in compressed form: the squares of the window
+// of clue k are win[win_start[k]] ... win[win_start[k + 1] - 1], and the clues
+// whose window contains square s are cell_clues[cell_start[s]] ..., and the
+// pairs holding clue k are clue_pairs[pair_start[k]] ...
+typedef struct {
+  uint nb_squares, nb_clues, nb_pairs;
+  int *clue_value;
+  uint *win_start, *win;
+  uint *cell_start, *cell_clues;
+  uint *pairs;  // overlapping clue pairs (a, b) with a < b
+  uint16_t *in_other;  // per pair, squares of window a in b, then of b in a
+  uint *pair_start, *clue_pairs;
+  bool *dup;  // window holding the same square twice (tiny wrapping grids)
+} deduce_t;
+
+static void deduce_init(deduce_t *d, cgame g) {
+  uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+  uint n = nb_rows * nb_cols;
+  d->nb_squares = n;
+  d->nb_clues = 0;
+  for (uint s = 0; s < n; s++) {
+    if (g->constraints[s] != UNCONSTRAINED) d->nb_clues++;
+  }
+  d->clue_value = malloc((d->nb_clues + 1) * sizeof(int));
+  d->win_start = malloc((d->nb_clues + 1) * sizeof(uint));
+  d->win = malloc((9 * d->nb_clues + 1) * sizeof(uint));
+  d->cell_start = calloc(n + 1, sizeof(uint));
+  assert(d->clue_value && d->win_start && d->win && d->cell_start);
+
+  // same windows as game_nb_neighbors
+  uint k = 0, len = 0;
+  for (uint s = 0; s < n; s++) {
+    if (g->constraints[s] == UNCONSTRAINED) continue;
+    uint buffer[9], nb;
+    const uint *window =
+        neighbor_list(g->neighbors, s / nb_cols, s % nb_cols, buffer, &nb);
+    d->clue_value[k] = g->constraints[s];
+    d->win_start[k] = len;
+    for (uint w = 0; w < nb; w++) {
+      d->win[len++] = window[w];
+      d->cell_start[window[w] + 1]++;
+    }
+    k++;
+  }
+  d->win_start[k] = len;
+
+  d->dup = calloc(d->nb_clues + 1, sizeof(bool));
+  assert(d->dup);
+  for (k = 0; k < d->nb_clues; k++) {
+    for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+      for (uint v = d->win_start[k]; v < w; v++) {
+        if (d->win[v] == d->win[w]) d->dup[k] = true;
+      }
+    }
+  }
+
+  for (uint s = 0; s < n; s++) d->cell_start[s + 1] += d->cell_start[s];
+  d->cell_clues = malloc((len + 1) * sizeof(uint));
+  uint *fill = malloc((n + 1) * sizeof(uint));
+  assert(d->cell_clues && fill);
+  memcpy(fill, d->cell_start, n * sizeof(uint));
+  for (k = 0; k < d->nb_clues; k++) {
+    for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+      d->cell_clues[fill[d->win[w]]++] = k;
+    }
+  }
+  free(fill);
+
+  // overlapping pairs, each listed once
+  uint cap = 16;
+  d->nb_pairs = 0;
+  d->pairs = malloc(2 * cap * sizeof(uint));
+  uint *seen = malloc((d->nb_clues + 1) * sizeof(uint));
+  assert(d->pairs && seen);
+  for (k = 0; k < d->nb_clues; k++) seen[k] = UINT32_MAX;
+  for (uint a = 0; a < d->nb_clues; a++) {
+    for (uint w = d->win_start[a]; w < d->win_start[a + 1]; w++) {
+      uint s = d->win[w];
+      for (uint c = d->cell_start[s]; c < d->cell_start[s + 1]; c++) {
+        uint b = d->cell_clues[c];
+        if (b <= a || seen[b] == a || d->dup[a] || d->dup[b]) continue;
+        seen[b] = a;
+        if (d->nb_pairs == cap) {
+          cap *= 2;
+          d->pairs = realloc(d->pairs, 2 * cap * sizeof(uint));
+          assert(d->pairs);
+        }
+        d->pairs[2 * d->nb_pairs] = a;
+        d->pairs[2 * d->nb_pairs + 1] = b;
+        d->nb_pairs++;
+      }
+    }
+  }
+  free(seen);
+
+  // positions of each window of a pair that the other window also holds
+  d->in_other = calloc(2 * d->nb_pairs + 1, sizeof(uint16_t));
+  assert(d->in_other);
+  for (uint p = 0; p < d->nb_pairs; p++) {
+    uint a = d->pairs[2 * p], b = d->pairs[2 * p + 1];
+    for (uint w = d->win_start[a]; w < d->win_start[a + 1]; w++) {
+      for (uint v = d->win_start[b]; v < d->win_start[b + 1]; v++) {
+        if (d->win[w] != d->win[v]) continue;
+        d->in_other[2 * p] |= 1 << (w - d->win_start[a]);
+        d->in_other[2 * p + 1] |= 1 << (v - d->win_start[b]);
+      }
+    }
+  }
+
+  d->pair_start = calloc(d->nb_clues + 1, sizeof(uint));
+  d->clue_pairs = malloc((2 * d->nb_pairs + 1) * sizeof(uint));
+  fill = malloc((d->nb_clues + 1) * sizeof(uint));
+  assert(d->pair_start && d->clue_pairs && fill);
+  for (uint p = 0; p < 2 * d->nb_pairs; p++) d->pair_start[d->pairs[p] + 1]++;
+  for (k = 0; k < d->nb_clues; k++) d->pair_start[k + 1] += d->pair_start[k];
+  memcpy(fill, d->pair_start, d->nb_clues * sizeof(uint));
+  for (uint p = 0; p < 2 * d->nb_pairs; p++) {
+    d->clue_pairs[fill[d->pairs[p]]++] = p / 2;
+  }
+  free(fill);
+}
+
+static void deduce_free(deduce_t *d) {
+  free(d->clue_value);
+  free(d->win_start);
+  free(d->win);
+  free(d->cell_start);
+  free(d->cell_clues);
+  free(d->pairs);
+  free(d->in_other);
+  free(d->pair_start);
+  free(d->clue_pairs);
+  free(d->dup);
+}
+
+// Paints the squares of window k that are still empty. Returns the number of
+// squares painted.
+static uint deduce_fill(const deduce_t *d, uint k, color *colors, color c) {
+  uint nb = 0;
+  for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+    if (colors[d->win[w]] == EMPTY) {
+      colors[d->win[w]] = c;
+      nb++;
+    }
+  }
+  return nb;
+}
+
+// Single clue rule: a window that already holds its number of black squares is
+// completed in white, one that needs all its empty squares in black. Returns
+// the number of squares painted, or -1 on contradiction.
+static int deduce_single(const deduce_t *d, uint k, color *colors) {
+  int blacks = 0, empties = 0;
+  for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+    if (colors[d->win[w]] == BLACK) blacks++;
+    if (colors[d->win[w]] == EMPTY) empties++;
+  }
+  int value = d->clue_value[k];
+  if (blacks > value || blacks + empties < value) return -1;
+  if (empties == 0) return 0;
+  if (blacks == value) return deduce_fill(d, k, colors, WHITE);
+  if (blacks + empties == value) return deduce_fill(d, k, colors, BLACK);
+  return 0;
+}
+
+// Parts of the two overlapping windows a and b of a pair.
+enum { ONLY_A, ONLY_B, SHARED };
+
+// Paints the empty squares of window k whose positions are (or are not) set in
+// the mask @p in_other.
+static uint deduce_fill_part(const deduce_t *d, uint k, uint in_other,
+                             bool shared, color *colors, color c) {
+  uint nb = 0;
+  for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+    uint s = d->win[w];
+    bool in = (in_other >> (w - d->win_start[k])) & 1;
+    if (colors[s] == EMPTY && in == shared) {
+      colors[s] = c;
+      nb++;
+    }
+  }
+  return nb;
+}
+
+// Clue pair rule: the black squares missing in windows a and b are split
+// between their shared part and their exclusive parts, which bounds each part
+// and may force it entirely. Sets forced[part] to the color of the empty
+// squares of each part, or EMPTY if it is not forced. Returns false on
+// contradiction.
+static bool deduce_pair_moves(const deduce_t *d, uint p, const color *colors,
+                              color forced[3]) {
+  uint a = d->pairs[2 * p], b = d->pairs[2 * p + 1];
+  uint a_in_b = d->in_other[2 * p], b_in_a = d->in_other[2 * p + 1];
+  int need_a = d->clue_value[a], need_b = d->clue_value[b];
+  int only_a = 0, only_b = 0, shared = 0;
+  for (uint w = d->win_start[a]; w < d->win_start[a + 1]; w++) {
+    uint s = d->win[w];
+    bool in_b = (a_in_b >> (w - d->win_start[a])) & 1;
+    if (colors[s] == BLACK) {
+      need_a--;
+      if (in_b) need_b--;
+    } else if (colors[s] == EMPTY) {
+      if (in_b) {
+        shared++;
+      } else {
+        only_a++;
+      }
+    }
+  }
+  for (uint w = d->win_start[b]; w < d->win_start[b + 1]; w++) {
+    uint s = d->win[w];
+    if ((b_in_a >> (w - d->win_start[b])) & 1) continue;
+    if (colors[s] == BLACK) need_b--;
+    if (colors[s] == EMPTY) only_b++;
+  }
+
+  // bounds on the black squares still to place in the shared part
+  int lo = 0, hi = shared;
+  if (need_a - only_a > lo) lo = need_a - only_a;
+  if (need_b - only_b > lo) lo = need_b - only_b;
+  if (need_a < hi) hi = need_a;
+  if (need_b < hi) hi = need_b;
+  if (lo > hi) return false;
+
+  forced[ONLY_A] = forced[ONLY_B] = forced[SHARED] = EMPTY;
+  if (only_a > 0 && need_a - lo == 0) {
+    forced[ONLY_A] = WHITE;
+  } else if (only_a > 0 && need_a - hi == only_a) {
+    forced[ONLY_A] = BLACK;
+  }
+  if (only_b > 0 && need_b - lo == 0) {
+    forced[ONLY_B] = WHITE;
+  } else if (only_b > 0 && need_b - hi == only_b) {
+    forced[ONLY_B] = BLACK;
+  }
+  if (shared > 0 && hi == 0) {
+    forced[SHARED] = WHITE;
+  } else if (shared > 0 && lo == shared) {
+    forced[SHARED] = BLACK;
+  }
+  return true;
+}
+
+// Applies the clue pair rule to pair p. Returns the number of squares
+// painted, or -1 on contradiction.
+static int deduce_pair(const deduce_t *d, uint p, color *colors) {
+  uint a = d->pairs[2 * p], b = d->pairs[2 * p + 1];
+  uint a_in_b = d->in_other[2 * p], b_in_a = d->in_other[2 * p + 1];
+  color forced[3];
+  if (!deduce_pair_moves(d, p, colors, forced)) return -1;
+  int nb = 0;
+  if (forced[ONLY_A] != EMPTY) {
+    nb += deduce_fill_part(d, a, a_in_b, false, colors, forced[ONLY_A]);
+  }
+  if (forced[ONLY_B] != EMPTY) {
+    nb += deduce_fill_part(d, b, b_in_a, false, colors, forced[ONLY_B]);
+  }
+  if (forced[SHARED] != EMPTY) {
+    nb += deduce_fill_part(d, a, a_in_b, true, colors, forced[SHARED]);
+  }
+  return nb;
+}
+
+// Applies the single clue rule (and the clue pair rule if @p pairs) until
+// nothing changes. Deductions are added to the counters when they are not
+// NULL. Returns false on contradiction.
+static bool deduce_propagate(const deduce_t *d, color *colors, bool pairs,
+                             uint *nb_single, uint *nb_pair) {
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (uint k = 0; k < d->nb_clues; k++) {
+      int nb = deduce_single(d, k, colors);
+      if (nb < 0) return false;
+      if (nb > 0) {
+        progress = true;
+        if (nb_single) *nb_single += nb;
+      }
+    }
+    if (progress || !pairs) continue;
+    for (uint p = 0; p < d->nb_pairs; p++) {
+      int nb = deduce_pair(d, p, colors);
+      if (nb < 0) return false;
+      if (nb > 0) {
+        progress = true;
+        if (nb_pair) *nb_pair += nb;
+        break;  // go back to the cheaper rule first
+      }
+    }
+  }
+  return true;
+}
+
+// Bounded lookahead: assumes one color for an empty square and propagates; if
+// that leads to a contradiction, the square gets the other color. Returns the
+// number of squares painted, or -1 if both colors fail for some square.
+static int deduce_lookahead(const deduce_t *d, color *colors, color *tmp) {
+  for (uint s = 0; s < d->nb_squares; s++) {
+    if (colors[s] != EMPTY || d->cell_start[s] == d->cell_start[s + 1]) {
+      continue;
+    }
+    memcpy(tmp, colors, d->nb_squares * sizeof(color));
+    tmp[s] = BLACK;
+    bool black_ok = deduce_propagate(d, tmp, true, NULL, NULL);
+    memcpy(tmp, colors, d->nb_squares * sizeof(color));
+    tmp[s] = WHITE;
+    bool white_ok = deduce_propagate(d, tmp, true, NULL, NULL);
+    if (!black_ok && !white_ok) return -1;
+    if (black_ok != white_ok) {
+      colors[s] = black_ok ? BLACK : WHITE;
+      return 1;  // let the cheaper rules exploit it first
+    }
+  }
+  return 0;
+}
+
+rating game_rate(cgame g) {
+  assert(g);
+  rating r = {TIER_NONE, 0, 0, 0, 0, 0};
+  deduce_t d;
+  deduce_init(&d, g);
+  uint n = d.nb_squares;
+  color *colors = malloc(n * sizeof(color));
+  color *tmp = malloc(n * sizeof(color));
+  assert(colors && tmp);
+  for (uint s = 0; s < n; s++) {
+    colors[s] = EMPTY;
+    // squares outside every clue window may take any color
+    if (d.cell_start[s] == d.cell_start[s + 1]) r.nb_free++;
+  }
+
+  bool ok = true;
+  while (ok) {
+    uint before = r.nb_single;
+    ok = deduce_propagate(&d, colors, false, &r.nb_single, NULL);
+    if (!ok) break;
+    if (r.nb_single > before && r.level < TIER_SINGLE) r.level = TIER_SINGLE;
+
+    before = r.nb_pair;
+    ok = deduce_propagate(&d, colors, true, &r.nb_single, &r.nb_pair);
+    if (!ok) break;
+    if (r.nb_pair > before) {
+      if (r.level < TIER_PAIR) r.level = TIER_PAIR;
+      continue;
+    }
+
+    int nb = deduce_lookahead(&d, colors, tmp);
+    if (nb < 0) ok = false;
+    if (nb <= 0) break;
+    r.nb_lookahead += nb;
+    r.level = TIER_LOOKAHEAD;
+  }
+
+  for (uint s = 0; s < n; s++) {
+    if (colors[s] == EMPTY && d.cell_start[s] != d.cell_start[s + 1]) {
+      r.nb_unknown++;
+    }
+  }
+  if (!ok) {
+    r.level = TIER_INVALID;
+  } else if (r.nb_unknown > 0) {
+    r.level = TIER_GUESS;
+  }
+
+  free(colors);
+  free(tmp);
+  deduce_free(&d);
+  return r;
+}
+
+/* ******************** search ******************** */
+
+#define DEFAULT_INTERVAL 65536          // nodes between two progress reports
+#define MEMO_MAX_ENTRIES (1u << 22)     // bound on the counting cache
+#define MEMO_MAX_ACTIVE (1u << 24)      // bound on the frontier tables
+#define MEMO_POOL_SIZE 4096             // initial size of the key pool
+
+typedef struct {
+  uint cell;
+  uint mark;    // trail length before the decision
+  bool second;  // second branch (WHITE) being explored
+} decision_t;
+
+typedef struct {
+  deduce_t d;
+  color *colors;
+  uint *trail;
+  uint trail_len;
+  uint *queue;  // clues to re-examine
+  uint queue_len;
+  bool *queued;
+  uint *changed;  // clues changed since their pairs were last queued
+  uint changed_len;
+  bool *is_changed;
+  uint *pair_queue;  // clue pairs to re-examine
+  uint pair_queue_len;
+  bool *pair_queued;
+  decision_t *stack;
+  uint depth;
+  game_solver_stats *stats;
+  game_solver_progress progress;
+  void *data;
+  uint64_t interval, next_report;
+  double start;
+  bool ok;           // the current colors may still lead to a solution
+  bool at_solution;  // the current colors are a solution already reported
+} solver_t;
+
+static double solver_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void solver_init(solver_t *sv, cgame g, game_solver_stats *stats,
+                        game_solver_progress progress, void *data,
+                        uint64_t interval) {
+  memset(stats, 0, sizeof(*stats));
+  deduce_init(&sv->d, g);
+  uint n = sv->d.nb_squares;
+  sv->colors = malloc((n + 1) * sizeof(color));
+  sv->trail = malloc((n + 1) * sizeof(uint));
+  sv->queue = malloc((sv->d.nb_clues + 1) * sizeof(uint));
+  sv->queued = malloc((sv->d.nb_clues + 1) * sizeof(bool));
+  sv->changed = malloc((sv->d.nb_clues + 1) * sizeof(uint));
+  sv->is_changed = malloc((sv->d.nb_clues + 1) * sizeof(bool));
+  sv->pair_queue = malloc((sv->d.nb_pairs + 1) * sizeof(uint));
+  sv->pair_queued = calloc(sv->d.nb_pairs + 1, sizeof(bool));
+  sv->stack = malloc((n + 1) * sizeof(decision_t));
+  assert(sv->colors && sv->trail && sv->queue && sv->queued && sv->stack);
+  assert(sv->changed && sv->is_changed && sv->pair_queue && sv->pair_queued);
+  for (uint s = 0; s < n; s++) sv->colors[s] = EMPTY;
+  sv->trail_len = 0;
+  sv->depth = 0;
+  // every clue and pair is examined once at the start
+  for (uint k = 0; k < sv->d.nb_clues; k++) {
+    sv->queue[k] = sv->changed[k] = k;
+    sv->queued[k] = sv->is_changed[k] = true;
+  }
+  sv->queue_len = sv->changed_len = sv->d.nb_clues;
+  sv->pair_queue_len = 0;
+  sv->stats = stats;
+  sv->progress = progress;
+  sv->data = data;
+  sv->interval = interval ? interval : DEFAULT_INTERVAL;
+  sv->next_report = sv->interval;
+  sv->start = solver_now();
+}
+
+static void solver_free(solver_t *sv) {
+  sv->stats->elapsed = solver_now() - sv->start;
+  deduce_free(&sv->d);
+  free(sv->colors);
+  free(sv->trail);
+  free(sv->queue);
+  free(sv->queued);
+  free(sv->changed);
+  free(sv->is_changed);
+  free(sv->pair_queue);
+  free(sv->pair_queued);
+  free(sv->stack);
+}
+
+// Calls the progress callback every interval nodes. Returns false if the
+// callback asked to stop.
+static bool solver_report(solver_t *sv, double progress, uint64_t nb_open) {
+  game_solver_stats *stats = sv->stats;
+  if (stats->nb_nodes < sv->next_report) return true;
+  sv->next_report = stats->nb_nodes + sv->interval;
+  if (!sv->progress) return true;
+  stats->progress = progress;
+  stats->nb_open = nb_open;
+  stats->elapsed = solver_now() - sv->start;
+  if (!sv->progress(stats, sv->data)) stats->cancelled = true;
+  return !stats->cancelled;
+}
+
+static void solver_assign(solver_t *sv, uint s, color c) {
+  sv->colors[s] = c;
+  sv->trail[sv->trail_len++] = s;
+  for (uint c = sv->d.cell_start[s]; c < sv->d.cell_start[s + 1]; c++) {
+    uint k = sv->d.cell_clues[c];
+    if (!sv->queued[k]) {
+      sv->queued[k] = true;
+      sv->queue[sv->queue_len++] = k;
+    }
+    if (!sv->is_changed[k]) {
+      sv->is_changed[k] = true;
+      sv->changed[sv->changed_len++] = k;
+    }
+  }
+}
+
+static void solver_undo(solver_t *sv, uint mark) {
+  while (sv->trail_len > mark) sv->colors[sv->trail[--sv->trail_len]] = EMPTY;
+}
+
+// Empties the work lists after a contradiction.
+static void solver_clear_queues(solver_t *sv) {
+  while (sv->queue_len > 0) sv->queued[sv->queue[--sv->queue_len]] = false;
+  while (sv->changed_len > 0) {
+    sv->is_changed[sv->changed[--sv->changed_len]] = false;
+  }
+  while (sv->pair_queue_len > 0) {
+    sv->pair_queued[sv->pair_queue[--sv->pair_queue_len]] = false;
+  }
+}
+
+// Single clue propagation over the queued clues. Returns false on
+// contradiction.
+static bool solver_propagate_single(solver_t *sv) {
+  const deduce_t *d = &sv->d;
+  while (sv->queue_len > 0) {
+    uint k = sv->queue[--sv->queue_len];
+    sv->queued[k] = false;
+    int blacks = 0, empties = 0;
+    for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+      if (sv->colors[d->win[w]] == BLACK) blacks++;
+      if (sv->colors[d->win[w]] == EMPTY) empties++;
+    }
+    int value = d->clue_value[k];
+    if (blacks > value || blacks + empties < value) return false;
+    if (empties == 0 || (blacks != value && blacks + empties != value)) {
+      continue;
+    }
+    color c = (blacks == value) ? WHITE : BLACK;
+    for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+      if (sv->colors[d->win[w]] == EMPTY) {
+        solver_assign(sv, d->win[w], c);
+        sv->stats->nb_propagations++;
+      }
+    }
+  }
+  return true;
+}
+
+// Assigns c to the empty squares of window k whose positions are (or are not)
+// set in the mask @p in_other.
+static void solver_fill_part(solver_t *sv, uint k, uint in_other, bool shared,
+                             color c) {
+  const deduce_t *d = &sv->d;
+  for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+    uint s = d->win[w];
+    bool in = (in_other >> (w - d->win_start[k])) & 1;
+    if (sv->colors[s] == EMPTY && in == shared) {
+      solver_assign(sv, s, c);
+      sv->stats->nb_propagations++;
+    }
+  }
+}
+
+// Single clue propagation, then the clue pair rule on the pairs holding a
+// clue whose window changed, one pair at a time so that the cheaper rule
+// exploits each deduction first. Returns false on contradiction.
+static bool solver_propagate(solver_t *sv) {
+  const deduce_t *d = &sv->d;
+  for (;;) {
+    if (!solver_propagate_single(sv)) {
+      solver_clear_queues(sv);
+      return false;
+    }
+    while (sv->changed_len > 0) {
+      uint k = sv->changed[--sv->changed_len];
+      sv->is_changed[k] = false;
+      for (uint q = d->pair_start[k]; q < d->pair_start[k + 1]; q++) {
+        uint p = d->clue_pairs[q];
+        if (!sv->pair_queued[p]) {
+          sv->pair_queued[p] = true;
+          sv->pair_queue[sv->pair_queue_len++] = p;
+        }
+      }
+    }
+    if (sv->pair_queue_len == 0) return true;
+
+    uint p = sv->pair_queue[--sv->pair_queue_len];
+    sv->pair_queued[p] = false;
+    uint a = d->pairs[2 * p], b = d->pairs[2 * p + 1];
+    uint a_in_b = d->in_other[2 * p], b_in_a = d->in_other[2 * p + 1];
+    color forced[3];
+    if (!deduce_pair_moves(d, p, sv->colors, forced)) {
+      solver_clear_queues(sv);
+      return false;
+    }
+    if (forced[ONLY_A] != EMPTY) {
+      solver_fill_part(sv, a, a_in_b, false, forced[ONLY_A]);
+    }
+    if (forced[ONLY_B] != EMPTY) {
+      solver_fill_part(sv, b, b_in_a, false, forced[ONLY_B]);
+    }
+    if (forced[SHARED] != EMPTY) {
+      solver_fill_part(sv, a, a_in_b, true, forced[SHARED]);
+    }
+  }
+}
+
+static void solver_position(const solver_t *sv, double *progress,
+                            uint64_t *nb_open) {
+  *progress = 0.0;
+  *nb_open = 0;
+  double weight = 0.5;
+  for (uint t = 0; t < sv->depth; t++, weight /= 2) {
+    if (sv->stack[t].second) {
+      *progress += weight;
+    } else {
+      (*nb_open)++;
+    }
+  }
+}
+
+// Prepares the search: squares outside every clue window are set to WHITE
+// unless every solution is wanted, then the clues are propagated.
+static void solver_start(solver_t *sv, bool all) {
+  const deduce_t *d = &sv->d;
+  for (uint s = 0; s < d->nb_squares; s++) {
+    if (!all && d->cell_start[s] == d->cell_start[s + 1]) {
+      sv->colors[s] = WHITE;
+    }
+  }
+  TRACE_BEGIN("presolve");
+  sv->ok = solver_propagate(sv);
+  sv->at_solution = false;
+  TRACE_END("presolve");
+}
+
+// Depth-first search with propagation, resumed where the previous call
+// stopped. Returns true when a solution is reached (left in sv->colors), the
+// next call then looks for the following one. Returns false once the search
+// is over or cancelled.
+static bool solver_next(solver_t *sv) {
+  uint n = sv->d.nb_squares;
+  game_solver_stats *stats = sv->stats;
+  for (;;) {
+    if (sv->ok) {
+      uint s = sv->depth ? sv->stack[sv->depth - 1].cell : 0;
+      while (s < n && sv->colors[s] != EMPTY) s++;
+      if (s == n) {
+        stats->nb_solutions++;
+        sv->ok = false;
+        sv->at_solution = true;
+        return true;
+      }
+      decision_t *top = &sv->stack[sv->depth++];
+      top->cell = s;
+      top->mark = sv->trail_len;
+      top->second = false;
+      if (sv->depth > stats->max_depth) stats->max_depth = sv->depth;
+      stats->nb_nodes++;
+      solver_assign(sv, s, BLACK);
+    } else {
+      if (!sv->at_solution) stats->nb_backtracks++;
+      sv->at_solution = false;
+      while (sv->depth > 0 && sv->stack[sv->depth - 1].second) sv->depth--;
+      if (sv->depth == 0) return false;
+      decision_t *top = &sv->stack[sv->depth - 1];
+      solver_undo(sv, top->mark);
+      top->second = true;
+      stats->nb_nodes++;
+      solver_assign(sv, top->cell, WHITE);
+    }
+
+    double progress;
+    uint64_t nb_open;
+    if (sv->progress && stats->nb_nodes >= sv->next_report) {
+      solver_position(sv, &progress, &nb_open);
+      if (!solver_report(sv, progress, nb_open)) {
+        sv->ok = false;
+        sv->depth = 0;
+        return false;
+      }
+    }
+    sv->ok = solver_propagate(sv);
+  }
+}
+
+bool game_solve_ext(game g, game_solver_stats *stats,
+                    game_solver_progress progress, void *data,
+                    uint64_t interval) {
+  TRACE_SCOPE("game_solve");
+  assert(g);
+  game_solver_stats local;
+  if (!stats) stats = &local;
+  solver_t sv;
+  TRACE_BEGIN("solver_init");
+  solver_init(&sv, g, stats, progress, data, interval);
+  TRACE_END("solver_init");
+  solver_start(&sv, false);
+  TRACE_BEGIN("search");
+  bool found = solver_next(&sv);
+  TRACE_END("search");
+  if (found) {
+    memcpy(g->colors, sv.colors, sv.d.nb_squares * sizeof(color));
+    game_touch_all(g);
+    game_forget_snapshots(g);
+  }
+  stats->progress = 1.0;
+  stats->nb_open = 0;
+  solver_free(&sv);
+  return found;
+}
+
+bool game_solve(game g) { return game_solve_ext(g, NULL, NULL, NULL, 0); }
+
+/* ******************** listing ******************** */
+
+struct game_solutions_s {
+  solver_t sv;
+  game_solver_stats stats;
+  uint8_t *bits;  // packed copy of the last solution
+};
+
+game_solutions game_solutions_new(cgame g) {
+  assert(g);
+  game_solutions it = malloc(sizeof(struct game_solutions_s));
+  assert(it);
+  solver_init(&it->sv, g, &it->stats, NULL, NULL, 0);
+  it->bits = malloc((it->sv.d.nb_squares + 7) / 8 + 1);
+  assert(it->bits);
+  solver_start(&it->sv, true);
+  return it;
+}
+
+const uint8_t *game_solutions_next(game_solutions it) {
+  assert(it);
+  if (!solver_next(&it->sv)) return NULL;
+  // same layout as game_pack
+  uint n = it->sv.d.nb_squares;
+  memset(it->bits, 0, (n + 7) / 8);
+  for (uint s = 0; s < n; s++) {
+    if (it->sv.colors[s] == BLACK) it->bits[s / 8] |= 1 << (s % 8);
+  }
+  return it->bits;
+}
+
+void game_solutions_delete(game_solutions it) {
+  if (!it) return;
+  solver_free(&it->sv);
+  free(it->bits);
+  free(it);
+}
+
+uint64_t game_for_each_solution(cgame g, game_solution_callback callback,
+                                void *data, uint64_t limit) {
+  TRACE_SCOPE("game_for_each_solution");
+  assert(g && callback);
+  game_solutions it = game_solutions_new(g);
+  uint64_t nb = 0;
+  const uint8_t *bits;
+  while ((limit == 0 || nb < limit) && (bits = game_solutions_next(it))) {
+    nb++;
+    if (!callback(bits, data)) break;
+  }
+  game_solutions_delete(it);
+  return nb;
+}
+
+/* ******************** counting ******************** */
+
+// Counting cache: squares are colored in row-major order, so the number of
+// completions from square p only depends on p and on the number of black
+// squares already placed in the windows that straddle p (the frontier).
+typedef struct {
+  uint64_t hash;
+  uint64_t value;
+  size_t key;  // offset of the frontier in the key pool
+  uint p;      // position + 1, 0 for an empty slot
+} memo_entry;
+
+typedef struct {
+  uint *act_start, *act;  // clues straddling each position
+  memo_entry *entries;
+  size_t capacity, size;
+  uint8_t *pool;
+  size_t pool_len, pool_cap;
+  uint8_t *key;  // scratch frontier
+} memo_t;
+
+static bool memo_init(memo_t *m, const deduce_t *d) {
+  uint n = d->nb_squares;
+  memset(m, 0, sizeof(*m));
+  uint *lo = malloc((d->nb_clues + 1) * sizeof(uint));
+  uint *hi = malloc((d->nb_clues + 1) * sizeof(uint));
+  m->act_start = calloc(n + 2, sizeof(uint));
+  assert(lo && hi && m->act_start);
+  size_t total = 0;
+  for (uint k = 0; k < d->nb_clues; k++) {
+    lo[k] = UINT32_MAX;
+    hi[k] = 0;
+    for (uint w = d->win_start[k]; w < d->win_start[k + 1]; w++) {
+      if (d->win[w] < lo[k]) lo[k] = d->win[w];
+      if (d->win[w] > hi[k]) hi[k] = d->win[w];
+    }
+    // straddling positions are lo < p <= hi
+    if (lo[k] < hi[k]) {
+      total += hi[k] - lo[k];
+      m->act_start[lo[k] + 2]++;
+      m->act_start[hi[k] + 2]--;
+    }
+  }
+  if (total > MEMO_MAX_ACTIVE) {
+    free(lo);
+    free(hi);
+    free(m->act_start);
+    m->act_start = NULL;
+    return false;
+  }
+  // prefix sums twice: first the number of straddling clues, then offsets
+  int running = 0;
+  for (uint p = 0; p <= n; p++) {
+    running += (int)m->act_start[p + 1];
+    m->act_start[p + 1] = running;
+  }
+  uint max_active = 0;
+  for (uint p = 1; p <= n + 1; p++) {
+    if (m->act_start[p] > max_active) max_active = m->act_start[p];
+    m->act_start[p] += m->act_start[p - 1];
+  }
+  m->act = malloc((total + 1) * sizeof(uint));
+  uint *fill = malloc((n + 1) * sizeof(uint));
+  m->key = malloc(max_active + 1);
+  // allocated up front so that empty frontiers never copy to a NULL pool
+  m->pool_cap = MEMO_POOL_SIZE;
+  m->pool = malloc(m->pool_cap);
+  assert(m->act && fill && m->key && m->pool);
+  memcpy(fill, m->act_start, (n + 1) * sizeof(uint));
+  for (uint k = 0; k < d->nb_clues; k++) {
+    for (uint p = lo[k] + 1; p <= hi[k] && lo[k] < hi[k]; p++) {
+      m->act[fill[p]++] = k;
+    }
+  }
+  free(fill);
+  free(lo);
+  free(hi);
+  return true;
+}
+
+static void memo_free(memo_t *m) {
+  free(m->act_start);
+  free(m->act);
+  free(m->entries);
+  free(m->pool);
+  free(m->key);
+}
+
+static uint memo_key(memo_t *m, uint p, const uint8_t *blacks,
+                     uint64_t *hash) {
+  uint len = 0;
+  uint64_t h = 0xCBF29CE484222325ULL ^ p;
+  for (uint a = m->act_start[p]; a < m->act_start[p + 1]; a++) {
+    m->key[len] = blacks[m->act[a]];
+    h = (h ^ m->key[len++]) * 0x100000001B3ULL;
+  }
+  *hash = h;
+  return len;
+}
+
+static memo_entry *memo_slot(memo_t *m, uint p, uint len, uint64_t hash) {
+  size_t h = hash & (m->capacity - 1);
+  while (m->entries[h].p) {
+    memo_entry *e = &m->entries[h];
+    if (e->hash == hash && e->p == p + 1 &&
+        memcmp(m->pool + e->key, m->key, len) == 0) {
+      return e;
+    }
+    h = (h + 1) & (m->capacity - 1);
+  }
+  return &m->entries[h];
+}
+
+static bool memo_lookup(memo_t *m, uint p, const uint8_t *blacks,
+                        uint64_t *value) {
+  if (!m->capacity) return false;
+  uint64_t hash;
+  uint len = memo_key(m, p, blacks, &hash);
+  memo_entry *e = memo_slot(m, p, len, hash);
+  if (!e->p) return false;
+  *value = e->value;
+  return true;
+}
+
+static void memo_insert(memo_t *m, uint p, const uint8_t *blacks,
+                        uint64_t value) {
+  if (m->size >= MEMO_MAX_ENTRIES) return;
+  if (2 * (m->size + 1) > m->capacity) {
+    size_t capacity = m->capacity ? 2 * m->capacity : 1024;
+    memo_entry *entries = calloc(capacity, sizeof(memo_entry));
+    if (!entries) return;
+    for (size_t n = 0; n < m->capacity; n++) {
+      if (!m->entries[n].p) continue;
+      size_t h = m->entries[n].hash & (capacity - 1);
+      while (entries[h].p) h = (h + 1) & (capacity - 1);
+      entries[h] = m->entries[n];
+    }
+    free(m->entries);
+    m->entries = entries;
+    m->capacity = capacity;
+  }
+  uint64_t hash;
+  uint len = memo_key(m, p, blacks, &hash);
+  if (m->pool_len + len > m->pool_cap) {
+    size_t cap = 2 * m->pool_cap;
+    while (cap < m->pool_len + len) cap *= 2;
+    uint8_t *pool = realloc(m->pool, cap);
+    if (!pool) return;
+    m->pool = pool;
+    m->pool_cap = cap;
+  }
+  memo_entry *e = memo_slot(m, p, len, hash);
+  if (e->p) return;
+  memcpy(m->pool + m->pool_len, m->key, len);
+  e->hash = hash;
+  e->value = value;
+  e->key = m->pool_len;
+  e->p = p + 1;
+  m->pool_len += len;
+  m->size++;
+}
+
+static uint64_t add_sat(uint64_t a, uint64_t b) {
+  return (a + b < a) ? UINT64_MAX : a + b;
+}
+
+typedef struct {
+  uint64_t acc;
+  uint8_t branch;  // 0: not started, 1: BLACK, 2: WHITE, 3: free square
+} count_frame;
+
+// Colors square p and checks the windows containing it.
+static bool count_assign(const deduce_t *d, uint8_t *blacks, uint8_t *unset,
+                         uint p, color c) {
+  bool ok = true;
+  for (uint i = d->cell_start[p]; i < d->cell_start[p + 1]; i++) {
+    uint k = d->cell_clues[i];
+    unset[k]--;
+    if (c == BLACK) blacks[k]++;
+    if (blacks[k] > d->clue_value[k] ||
+        blacks[k] + unset[k] < d->clue_value[k]) {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static void count_unassign(const deduce_t *d, uint8_t *blacks, uint8_t *unset,
+                           uint p, color c) {
+  for (uint i = d->cell_start[p]; i < d->cell_start[p + 1]; i++) {
+    uint k = d->cell_clues[i];
+    unset[k]++;
+    if (c == BLACK) blacks[k]--;
+  }
+}
+
+// Tries one color for square p; the square is left uncolored on failure.
+static bool count_try(solver_t *sv, uint8_t *blacks, uint8_t *unset, uint p,
+                      color c) {
+  sv->stats->nb_nodes++;
+  if (count_assign(&sv->d, blacks, unset, p, c)) {
+    if (p + 1 > sv->stats->max_depth) sv->stats->max_depth = p + 1;
+    return true;
+  }
+  sv->stats->nb_backtracks++;
+  count_unassign(&sv->d, blacks, unset, p, c);
+  return false;
+}
+
+// Counts the solutions by coloring the squares in row-major order, with the
+// frontier cache. Returns 0 if the progress callback cancelled the count.
+static uint64_t solver_count(solver_t *sv) {
+  const deduce_t *d = &sv->d;
+  game_solver_stats *stats = sv->stats;
+  uint n = d->nb_squares;
+  uint8_t *blacks = calloc(d->nb_clues + 1, 1);
+  uint8_t *unset = malloc(d->nb_clues + 1);
+  count_frame *frames = malloc((n + 1) * sizeof(count_frame));
+  assert(blacks && unset && frames);
+
+  // windows too small for their clue can never be satisfied
+  uint64_t result = 1;
+  for (uint k = 0; k < d->nb_clues; k++) {
+    unset[k] = d->win_start[k + 1] - d->win_start[k];
+    if (unset[k] < d->clue_value[k]) result = 0;
+  }
+  memo_t memo;
+  bool cached = (result != 0) && memo_init(&memo, d);
+
+  uint p = 0;
+  bool descend = (result != 0);
+  while (descend) {
+    count_frame *f = &frames[p];
+    uint64_t value;
+    if (sv->progress && stats->nb_nodes >= sv->next_report) {
+      double progress = 0.0, weight = 0.5;
+      uint64_t nb_open = 0;
+      for (uint t = 0; t < p; t++) {
+        if (frames[t].branch == 3) continue;
+        if (frames[t].branch == 2) progress += weight;
+        if (frames[t].branch == 1) nb_open++;
+        weight /= 2;
+      }
+      if (!solver_report(sv, progress, nb_open)) {
+        result = 0;
+        break;
+      }
+    }
+
+    // enter square p
+    if (p == n) {
+      result = 1;
+      stats->nb_solutions++;
+    } else if (cached && memo_lookup(&memo, p, blacks, &value)) {
+      stats->nb_cache_hits++;
+      result = value;
+    } else if (d->cell_start[p] == d->cell_start[p + 1]) {
+      f->branch = 3;  // free square, both colors give the same completions
+      p++;
+      continue;
+    } else {
+      f->acc = 0;
+      f->branch = 1;
+      if (count_try(sv, blacks, unset, p, BLACK)) {
+        p++;
+        continue;
+      }
+      f->branch = 2;
+      if (count_try(sv, blacks, unset, p, WHITE)) {
+        p++;
+        continue;
+      }
+      result = 0;
+      if (cached) memo_insert(&memo, p, blacks, 0);
+    }
+
+    // hand the result back up until a frame has another branch to explore
+    descend = false;
+    while (p > 0) {
+      f = &frames[--p];
+      if (f->branch == 3) {
+        result = add_sat(result, result);
+      } else {
+        count_unassign(d, blacks, unset, p, f->branch == 1 ? BLACK : WHITE);
+        f->acc = add_sat(f->acc, result);
+        if (f->branch == 1) {
+          f->branch = 2;
+          if (count_try(sv, blacks, unset, p, WHITE)) {
+            p++;
+            descend = true;
+            break;
+          }
+        }
+        result = f->acc;
+      }
+      if (cached) memo_insert(&memo, p, blacks, result);
+    }
+  }
+
+  if (cached) memo_free(&memo);
+  free(blacks);
+  free(unset);
+  free(frames);
+  return stats->cancelled ? 0 : result;
+}
+
+uint64_t game_nb_solutions_ext(cgame g, game_solver_stats *stats,
+                               game_solver_progress progress, void *data,
+                               uint64_t interval) {
+  TRACE_SCOPE("game_nb_solutions");
+  assert(g);
+  game_solver_stats local;
+  if (!stats) stats = &local;
+  solver_t sv;
+  TRACE_BEGIN("solver_init");
+  solver_init(&sv, g, stats, progress, data, interval);
+  TRACE_END("solver_init");
+  TRACE_BEGIN("count");
+  uint64_t count = solver_count(&sv);
+  TRACE_END("count");
+  stats->nb_solutions = count;
+  stats->progress = 1.0;
+  stats->nb_open = 0;
+  solver_free(&sv);
+  return count;
+}
+
+uint game_nb_solutions(cgame g) {
+  uint64_t count = game_nb_solutions_ext(g, NULL, NULL, NULL, 0);
+  return count > UINT_MAX ? UINT_MAX : (uint)count;
+}
@@ -9,10 +9,82 @@
 #ifndef __GAME_TOOLS_H__
 #define __GAME_TOOLS_H__
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "game.h"
 #include "game_struct.h"
+#include "rng.h"
+
+/**
+ * @brief Deduction tiers used to rate a game, from the easiest to the hardest.
+ **/
+typedef enum {
+  TIER_NONE,      /**< nothing to deduce */
+  TIER_SINGLE,    /**< each clue considered alone is enough */
+  TIER_PAIR,      /**< overlapping pairs of clues are needed */
+  TIER_LOOKAHEAD, /**< one-square hypotheses refuted by propagation */
+  TIER_GUESS,     /**< deduction stalls, guessing is required */
+  TIER_INVALID    /**< the clues contradict each other */
+} tier;
+
+/**
+ * @brief Difficulty rating of a game, see @ref game_rate.
+ **/
+typedef struct {
+  tier level;        /**< highest tier needed */
+  uint nb_single;    /**< squares deduced with the single clue rule */
+  uint nb_pair;      /**< squares deduced with the clue pair rule */
+  uint nb_lookahead; /**< squares deduced by lookahead */
+  uint nb_free;      /**< squares outside every clue window */
+  uint nb_unknown;   /**< squares left undetermined */
+} rating;
+
+/**
+ * @brief Statistics filled by @ref game_solve_ext and
+ * @ref game_nb_solutions_ext.
+ **/
+typedef struct {
+  uint64_t nb_nodes;        /**< search nodes visited (colors tried) */
+  uint64_t nb_propagations; /**< squares deduced by propagation */
+  uint64_t nb_backtracks;   /**< dead ends */
+  uint64_t nb_cache_hits;   /**< subproblems answered by the counting cache */
+  uint64_t nb_solutions;    /**< solutions found so far */
+  uint max_depth;           /**< maximum search depth */
+  uint64_t nb_open;         /**< unexplored subtrees left on the search stack */
+  double progress;          /**< estimated explored fraction, in [0, 1] */
+  double elapsed;           /**< elapsed time, in seconds */
+  bool cancelled;           /**< the progress callback stopped the search */
+} game_solver_stats;
+
+/**
+ * @brief Progress callback of the solver.
+ * @param stats the statistics so far
+ * @param data the user data given to the solver
+ * @return true to continue, false to cancel the search
+ **/
+typedef bool (*game_solver_progress)(const game_solver_stats* stats,
+                                     void* data);
+
+/**
+ * @brief Callback receiving each solution listed by
+ * @ref game_for_each_solution.
+ * @param bits the solution as a packed coloring (see grid.h), valid until the
+ * callback returns
+ * @param data the user data given to @ref game_for_each_solution
+ * @return true to continue, false to stop the listing
+ **/
+typedef bool (*game_solution_callback)(const uint8_t* bits, void* data);
+
+/**
+ * @brief Iterator over the solutions of a game, see @ref game_solutions_new.
+ **/
+typedef struct game_solutions_s* game_solutions;
+
+/**
+ * @brief Largest number of squares (rows times columns) of a loaded game.
+ **/
+#define GAME_MAX_SQUARES (1u << 24)
 
 /**
  * @name Game Tools
@@ -35,6 +107,47 @@ game game_load(char* filename);
  **/
 void game_save(cgame g, char* filename);
 
+/**
+ * @brief Reads the next game description from an already opened stream.
+ * @details Same format as @ref game_load. Several games may be stored one
+ * after the other in the same stream.
+ * @param file input stream
+ * @return the loaded game, or NULL at end of stream or on error: invalid
+ * header (sizes not in 1..@ref GAME_MAX_SQUARES squares, wrapping not 0 or 1,
+ * unknown neighbourhood) or unknown constraint or color character
+ **/
+game game_load_file(FILE* file);
+
+/**
+ * @brief Writes a game description to an already opened stream.
+ * @details Same format as @ref game_save. The stream is not closed.
+ * @param g game to save
+ * @param file output stream
+ **/
+void game_save_file(cgame g, FILE* file);
+
+/**
+ * @brief Saves a game together with its move history.
+ * @details The file starts with the game as written by @ref game_save, so it
+ * can also be loaded with @ref game_load. It is followed by a line with the
+ * number of moves in the history and the current position, then one line per
+ * move: "<i> <j> <previous color> <applied color>" with colors written as in
+ * the game description.
+ * @param g game to save
+ * @param filename output file
+ * @return true if the file was written
+ **/
+bool game_save_journal(cgame g, char* filename);
+
+/**
+ * @brief Loads a game and its move history saved by @ref game_save_journal.
+ * @details The whole history is restored: moves after the saved position can
+ * be redone, and @ref game_goto can reach any position at once.
+ * @param filename input file
+ * @return the loaded game, or NULL if the file is invalid
+ **/
+game game_load_journal(char* filename);
+
 /**
  * @brief Computes the solution of a given game
  * @param g the game to solve
@@ -48,13 +161,111 @@ bool game_solve(game g);
  * @brief Computes the total number of solutions of a given game.
  * @param g the game
  * @details The game @p g must be unchanged.
- * @return the number of solutions
+ * @return the number of solutions (saturated to UINT_MAX)
  */
 uint game_nb_solutions(cgame g);
 
+/**
+ * @brief Solves a game and reports statistics on the search.
+ * @details Same as @ref game_solve. If @p progress is not NULL, it is called
+ * every @p interval search nodes (65536 if @p interval is 0) and may cancel
+ * the search, in which case false is returned and @p g is unchanged.
+ * @param g the game to solve
+ * @param stats the statistics to fill, or NULL
+ * @param progress the progress callback, or NULL
+ * @param data user data passed to @p progress
+ * @param interval number of nodes between two calls to @p progress
+ * @return true if a solution is found, false otherwise
+ */
+bool game_solve_ext(game g, game_solver_stats* stats,
+                    game_solver_progress progress, void* data,
+                    uint64_t interval);
+
+/**
+ * @brief Counts the solutions of a game and reports statistics on the search.
+ * @details Same as @ref game_nb_solutions, with the progress callback
+ * described in @ref game_solve_ext. A cancelled count returns 0.
+ * @return the number of solutions (saturated to UINT64_MAX)
+ */
+uint64_t game_nb_solutions_ext(cgame g, game_solver_stats* stats,
+                               game_solver_progress progress, void* data,
+                               uint64_t interval);
+
+/**
+ * @brief Lists the solutions of a game one at a time.
+ * @details The solutions are found by the search of @ref game_solve, resumed
+ * after each one, so the memory used does not depend on their number. Every
+ * solution is listed, including both colors of the squares outside every
+ * clue window: there are @ref game_nb_solutions of them. The colors of @p g
+ * are ignored.
+ * @param g the game
+ * @param callback the function called with each solution
+ * @param data user data passed to @p callback
+ * @param limit the maximum number of solutions to list, 0 for all of them
+ * @return the number of solutions passed to @p callback
+ */
+uint64_t game_for_each_solution(cgame g, game_solution_callback callback,
+                                void* data, uint64_t limit);
+
+/**
+ * @brief Creates an iterator over the solutions of a game.
+ * @details The pull-style counterpart of @ref game_for_each_solution: each
+ * call to @ref game_solutions_next resumes the search until the next
+ * solution. The iterator keeps its own copy of what it needs from @p g.
+ * @param g the game
+ * @return the iterator, to free with @ref game_solutions_delete
+ */
+game_solutions game_solutions_new(cgame g);
+
+/**
+ * @brief Finds the next solution.
+ * @param it the iterator
+ * @return the solution as a packed coloring (see grid.h), valid until the
+ * next call, or NULL when every solution has been listed
+ */
+const uint8_t* game_solutions_next(game_solutions it);
+
+/**
+ * @brief Deletes an iterator (which may be NULL).
+ * @param it the iterator
+ */
+void game_solutions_delete(game_solutions it);
+
+/**
+ * @brief Rates the difficulty of a game by pure logical deduction.
+ * @details Starting from an empty grid, squares are deduced with increasingly
+ * expensive rules: single clues, pairs of overlapping clues, then one-square
+ * lookahead. The rating reports the highest tier needed and how many squares
+ * each tier deduced. No search is ever performed: if deduction stalls, the
+ * level is TIER_GUESS. The colors of @p g are ignored and left unchanged.
+ * @param g the game
+ * @return the rating
+ */
+rating game_rate(cgame g);
+
+/**
+ * @brief Creates a random game drawn from the global rand() stream.
+ * @details Equivalent to @ref game_random_r with a generator seeded from
+ * rand(), so that srand() still controls the result.
+ * @return the created game, or NULL if it could not be built
+ */
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
                  bool with_solution, float black_rate, float constraint_rate);
 
+/**
+ * @brief Creates a random game drawn from an explicit generator.
+ * @details The grid is first filled with black squares (with probability
+ * @p black_rate) and white squares, then about @p constraint_rate of the
+ * squares receive the constraint matching this coloring. This function is
+ * reentrant: games built from generators seeded the same way are identical.
+ * @param state the random generator, updated by the call
+ * @return the created game (solved if @p with_solution), or NULL if it could
+ * not be built
+ */
+game game_random_r(uint nb_rows, uint nb_cols, bool wrapping,
+                   neighbourhood neigh, bool with_solution, float black_rate,
+                   float constraint_rate, rng* state);
+
 /**
  *
  *
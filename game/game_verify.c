@@ -0,0 +1,473 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "grid.h"
+#include "trace.h"
+
+#define MAP_THRESHOLD 65536  // files from this size on are mapped, not read
+
+/* ******************** submissions ******************** */
+
+typedef enum { VERDICT_OK, VERDICT_WRONG, VERDICT_INVALID } verdict_kind;
+
+typedef struct {
+  verdict_kind kind;
+  uint i, j;           // first failing square (VERDICT_WRONG)
+  const char *reason;  // VERDICT_INVALID
+} verdict;
+
+// An input file, holding one or more boards written one after the other in
+// the game file format. Its verdicts are filled by a worker.
+typedef struct {
+  char *path;
+  verdict *verdicts;
+  size_t nb_boards;
+  const char *error;  // the file could not be read
+} input;
+
+typedef struct {
+  cgame puzzle;
+  input *inputs;
+  size_t nb_inputs;
+  size_t next;  // next input to verify, shared by the workers
+} job;
+
+static void add_input(input **inputs, size_t *nb, size_t *cap, char *path) {
+  if (*nb == *cap) {
+    *cap = *cap ? 2 * *cap : 64;
+    *inputs = realloc(*inputs, *cap * sizeof(input));
+    if (!*inputs) {
+      fprintf(stderr, "Allocation mémoire échouée\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  (*inputs)[(*nb)++] = (input){path, NULL, 0, NULL};
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Adds the regular files of a directory, sorted by name.
+static bool add_directory(input **inputs, size_t *nb, size_t *cap,
+                          const char *dir_path) {
+  DIR *dir = opendir(dir_path);
+  if (!dir) return false;
+  char **names = NULL;
+  size_t nb_names = 0, cap_names = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') continue;
+    char *path = malloc(strlen(dir_path) + strlen(entry->d_name) + 2);
+    sprintf(path, "%s/%s", dir_path, entry->d_name);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+      free(path);
+      continue;
+    }
+    if (nb_names == cap_names) {
+      cap_names = cap_names ? 2 * cap_names : 64;
+      names = realloc(names, cap_names * sizeof(char *));
+    }
+    names[nb_names++] = path;
+  }
+  closedir(dir);
+  if (nb_names > 0) qsort(names, nb_names, sizeof(char *), compare_names);
+  for (size_t k = 0; k < nb_names; k++) add_input(inputs, nb, cap, names[k]);
+  free(names);
+  return true;
+}
+
+// Adds the paths listed one per line in a file, or in the standard input.
+static bool add_list(input **inputs, size_t *nb, size_t *cap,
+                     const char *list_path) {
+  FILE *list = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "r");
+  if (!list) return false;
+  char *line = NULL;
+  size_t line_cap = 0;
+  ssize_t len;
+  while ((len = getline(&line, &line_cap, list)) != -1) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (len > 0) add_input(inputs, nb, cap, strdup(line));
+  }
+  free(line);
+  if (list != stdin) fclose(list);
+  return true;
+}
+
+/* ******************** reading ******************** */
+
+// Contents of an input, mapped or read into memory.
+typedef struct {
+  const char *data;
+  size_t size;
+  bool mapped;
+} contents;
+
+static bool read_all(int fd, contents *c, size_t hint) {
+  size_t cap = hint > 0 ? hint + 1 : 4096, size = 0;
+  char *data = malloc(cap);
+  if (!data) return false;
+  for (;;) {
+    if (size == cap) {
+      cap *= 2;
+      char *bigger = realloc(data, cap);
+      if (!bigger) {
+        free(data);
+        return false;
+      }
+      data = bigger;
+    }
+    ssize_t n = read(fd, data + size, cap - size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      free(data);
+      return false;
+    }
+    if (n == 0) break;
+    size += n;
+  }
+  *c = (contents){data, size, false};
+  return true;
+}
+
+// Small files are read: mapping costs more than copying them, and a large
+// directory would exhaust the mappings allowed to a process.
+static bool open_contents(const char *path, contents *c) {
+  if (strcmp(path, "-") == 0) return read_all(STDIN_FILENO, c, 0);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = false;
+  if (fstat(fd, &st) == 0 && st.st_size >= MAP_THRESHOLD) {
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+      *c = (contents){data, st.st_size, true};
+      ok = true;
+    }
+  }
+  if (!ok) ok = read_all(fd, c, st.st_size > 0 ? st.st_size : 0);
+  close(fd);
+  return ok;
+}
+
+static void close_contents(contents *c) {
+  if (c->mapped) {
+    munmap((void *)c->data, c->size);
+  } else {
+    free((void *)c->data);
+  }
+}
+
+/* ******************** parsing ******************** */
+
+typedef struct {
+  const char *p, *end;
+} cursor;
+
+static void skip_blanks(cursor *c) {
+  while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' ||
+                           *c->p == '\n')) {
+    c->p++;
+  }
+}
+
+static bool parse_uint(cursor *c, uint *value) {
+  while (c->p < c->end && (*c->p == ' ' || *c->p == '\t')) c->p++;
+  if (c->p == c->end || *c->p < '0' || *c->p > '9') return false;
+  uint v = 0;
+  while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+    if (v > (UINT_MAX - 9) / 10) return false;
+    v = 10 * v + (*c->p++ - '0');
+  }
+  *value = v;
+  return true;
+}
+
+static const char *next_line(cursor *c) {
+  if (c->p >= c->end) return c->end;
+  const char *eol = memchr(c->p, '\n', c->end - c->p);
+  return eol ? eol : c->end;
+}
+
+// Parses the next board of the stream into a packed coloring. The clues and
+// options of the board are not checked, only its size and its colors. Returns
+// NULL on success, or the reason why the board is invalid. After an invalid
+// header, the rest of the stream cannot be split and *resync is false.
+static const char *parse_board(cursor *c, cgame puzzle, uint8_t *bits,
+                               size_t *first_empty, bool *resync) {
+  uint nb_rows, nb_cols, wrapping, neigh;
+  *resync = true;
+  if (!parse_uint(c, &nb_rows) || !parse_uint(c, &nb_cols) ||
+      !parse_uint(c, &wrapping) || !parse_uint(c, &neigh)) {
+    *resync = false;
+    return "bad header";
+  }
+  c->p = next_line(c);
+  if (nb_rows != game_nb_rows(puzzle) || nb_cols != game_nb_cols(puzzle)) {
+    // skip to the next header, without trusting the row count further than
+    // the data goes
+    for (uint i = 0; i < nb_rows && c->p < c->end; i++) {
+      c->p++;
+      c->p = next_line(c);
+    }
+    return "size mismatch";
+  }
+  const char *reason = NULL;
+  memset(bits, 0, game_packed_size(puzzle));
+  *first_empty = SIZE_MAX;
+  uint i = 0;
+  for (; i < nb_rows && c->p < c->end; i++) {
+    c->p++;  // end of the previous line
+    const char *eol = next_line(c);
+    uint j = 0;
+    for (const char *q = c->p; !reason && q < eol && j < nb_cols; j++) {
+      char clue = *q++;
+      while (q < eol && (*q == ' ' || *q == '\t')) q++;
+      if (clue != '-' && (clue < '0' || clue > '9')) {
+        reason = "bad constraint";
+      } else if (q == eol) {
+        break;
+      } else if (*q == 'b') {
+        size_t s = (size_t)i * nb_cols + j;
+        bits[s / 8] |= 1 << (s % 8);
+      } else if (*q == 'e') {
+        size_t s = (size_t)i * nb_cols + j;
+        if (*first_empty == SIZE_MAX) *first_empty = s;
+      } else if (*q != 'w') {
+        reason = "bad color";
+      }
+      q++;
+    }
+    if (!reason && j < nb_cols) reason = "truncated board";
+    c->p = eol;
+  }
+  if (!reason && i < nb_rows) reason = "truncated board";
+  return reason;
+}
+
+// First square, in row-major order, that is empty or whose clue is not met.
+static size_t first_failure(game g, const uint8_t *bits, size_t first_empty) {
+  game_unpack(g, bits);
+  uint nb_cols = game_nb_cols(g);
+  for (size_t s = 0; s < first_empty; s++) {
+    uint i = s / nb_cols, j = s % nb_cols;
+    constraint n = game_get_constraint(g, i, j);
+    if (n != UNCONSTRAINED && game_nb_neighbors(g, i, j, BLACK) != n) return s;
+  }
+  return first_empty;
+}
+
+/* ******************** verification ******************** */
+
+static void verify_input(cgame puzzle, game scratch, input *in) {
+  TRACE_SCOPE("verify_input");
+  contents data;
+  if (!open_contents(in->path, &data)) {
+    in->error = "cannot read";
+    return;
+  }
+
+  // all the boards of the input are checked in one batch
+  size_t size = game_packed_size(puzzle), cap = 1;
+  uint8_t *bits = malloc(cap * size);
+  size_t *empties = malloc(cap * sizeof(size_t));
+  in->verdicts = malloc(cap * sizeof(verdict));
+  cursor c = {data.data, data.data + data.size};
+  for (skip_blanks(&c); c.p < c.end; skip_blanks(&c)) {
+    if (in->nb_boards == cap) {
+      cap *= 2;
+      bits = realloc(bits, cap * size);
+      empties = realloc(empties, cap * sizeof(size_t));
+      in->verdicts = realloc(in->verdicts, cap * sizeof(verdict));
+    }
+    if (!bits || !empties || !in->verdicts) {
+      fprintf(stderr, "Allocation mémoire échouée\n");
+      exit(EXIT_FAILURE);
+    }
+    size_t k = in->nb_boards++;
+    bool resync;
+    const char *reason = parse_board(&c, puzzle, bits + k * size, &empties[k],
+                                     &resync);
+    in->verdicts[k] = (verdict){reason ? VERDICT_INVALID : VERDICT_OK, 0, 0,
+                                reason};
+    if (!resync) break;
+  }
+  close_contents(&data);
+  if (in->nb_boards == 0) in->error = "no board";
+
+  bool *ok = malloc((in->nb_boards + 1) * sizeof(bool));
+  if (!ok) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    exit(EXIT_FAILURE);
+  }
+  game_check_solutions(puzzle, bits, in->nb_boards, ok);
+  uint nb_cols = game_nb_cols(puzzle);
+  for (size_t k = 0; k < in->nb_boards; k++) {
+    verdict *v = &in->verdicts[k];
+    if (v->kind == VERDICT_INVALID || (ok[k] && empties[k] == SIZE_MAX)) {
+      continue;
+    }
+    size_t s = first_failure(scratch, bits + k * size, empties[k]);
+    *v = (verdict){VERDICT_WRONG, s / nb_cols, s % nb_cols, NULL};
+  }
+  free(ok);
+  free(bits);
+  free(empties);
+}
+
+static void *worker_run(void *arg) {
+  job *jb = arg;
+  game scratch = game_copy(jb->puzzle);
+  for (;;) {
+    size_t k = __atomic_fetch_add(&jb->next, 1, __ATOMIC_RELAXED);
+    if (k >= jb->nb_inputs) break;
+    verify_input(jb->puzzle, scratch, &jb->inputs[k]);
+  }
+  game_delete(scratch);
+  return NULL;
+}
+
+/* ******************** main ******************** */
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options] <puzzle> [<input>...]\n"
+          "Each input is a file of one or more boards, a directory of such "
+          "files,\nor - for the standard input.\n"
+          "  -l <list>     also check the files listed in <list> (- for the "
+          "standard input)\n"
+          "  -t <threads>  number of worker threads (default: all cores)\n"
+          "  -q            only print the submissions that are not accepted\n"
+          "  --trace <file> write a Chrome trace of the verification\n",
+          prog);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+  long nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  uint nb_threads = nb_cores > 0 ? nb_cores : 1;
+  bool quiet = false;
+  input *inputs = NULL;
+  size_t nb_inputs = 0, cap_inputs = 0;
+  char *list_path = NULL;
+  trace_parse_args(&argc, argv);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "l:t:qh")) != -1) {
+    switch (opt) {
+      case 'l':
+        list_path = optarg;
+        break;
+      case 't':
+        nb_threads = atoi(optarg);
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (nb_threads == 0 || optind >= argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  game puzzle = game_load(argv[optind]);
+  if (!puzzle) {
+    fprintf(stderr, "error loading game from file %s\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+  for (int a = optind + 1; a < argc; a++) {
+    struct stat st;
+    if (stat(argv[a], &st) == 0 && S_ISDIR(st.st_mode)) {
+      add_directory(&inputs, &nb_inputs, &cap_inputs, argv[a]);
+    } else {
+      add_input(&inputs, &nb_inputs, &cap_inputs, strdup(argv[a]));
+    }
+  }
+  if (list_path && !add_list(&inputs, &nb_inputs, &cap_inputs, list_path)) {
+    fprintf(stderr, "Cannot open file %s\n", list_path);
+    return EXIT_FAILURE;
+  }
+
+  double start = now();
+  job jb = {puzzle, inputs, nb_inputs, 0};
+  if (nb_threads > nb_inputs) nb_threads = nb_inputs > 0 ? nb_inputs : 1;
+  pthread_t *workers = malloc(nb_threads * sizeof(pthread_t));
+  if (!workers) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    return EXIT_FAILURE;
+  }
+  for (uint t = 0; t < nb_threads; t++) {
+    pthread_create(&workers[t], NULL, worker_run, &jb);
+  }
+  for (uint t = 0; t < nb_threads; t++) pthread_join(workers[t], NULL);
+  free(workers);
+  double elapsed = now() - start;
+
+  // one line per board: its name, then OK, WRONG <i> <j> or INVALID <reason>;
+  // the boards of a file holding several are named <path>:<index from 1>
+  size_t nb_boards = 0, nb_accepted = 0, nb_errors = 0;
+  for (size_t k = 0; k < nb_inputs; k++) {
+    input *in = &inputs[k];
+    if (in->error) {
+      printf("%s\tINVALID %s\n", in->path, in->error);
+      nb_errors++;
+    }
+    for (size_t b = 0; b < in->nb_boards; b++) {
+      verdict *v = &in->verdicts[b];
+      nb_boards++;
+      nb_accepted += (v->kind == VERDICT_OK);
+      if (quiet && v->kind == VERDICT_OK) continue;
+      if (in->nb_boards > 1) {
+        printf("%s:%zu\t", in->path, b + 1);
+      } else {
+        printf("%s\t", in->path);
+      }
+      if (v->kind == VERDICT_OK) {
+        printf("OK\n");
+      } else if (v->kind == VERDICT_WRONG) {
+        printf("WRONG %u %u\n", v->i, v->j);
+      } else {
+        printf("INVALID %s\n", v->reason);
+      }
+    }
+    free(in->verdicts);
+    free(in->path);
+  }
+  free(inputs);
+  game_delete(puzzle);
+  fprintf(stderr, "%zu boards, %zu accepted, %zu unreadable inputs, %.0f/s\n",
+          nb_boards, nb_accepted, nb_errors,
+          elapsed > 0 ? nb_boards / elapsed : 0.0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,450 @@
+#include "grid.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_struct.h"
+
+#if defined(__x86_64__)
+#define GRID_X86
+#include <immintrin.h>
+#endif
+
+#define VECTOR_MAX 32  // widest vector in bytes (AVX2)
+
+typedef enum { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 } simd_level;
+
+// Best instruction set of the processor, capped by GAME_SIMD.
+static simd_level simd_detect(void) {
+  simd_level level = SIMD_SCALAR;
+#ifdef GRID_X86
+  level = SIMD_SSE2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) level = SIMD_AVX2;
+#endif
+  const char *cap = getenv("GAME_SIMD");
+  if (cap && strcmp(cap, "scalar") == 0) {
+    level = SIMD_SCALAR;
+  } else if (cap && strcmp(cap, "sse2") == 0 && level > SIMD_SSE2) {
+    level = SIMD_SSE2;
+  }
+  return level;
+}
+
+/* ******************** packing ******************** */
+
+size_t game_packed_size(cgame g) {
+  return ((size_t)g->row * g->column + 7) / 8;
+}
+
+void game_pack(cgame g, uint8_t *bits) {
+  size_t n = (size_t)g->row * g->column;
+  memset(bits, 0, (n + 7) / 8);
+  for (size_t s = 0; s < n; s++) {
+    if (g->colors[s] == BLACK) bits[s / 8] |= 1 << (s % 8);
+  }
+}
+
+void game_unpack(game g, const uint8_t *bits) {
+  size_t n = (size_t)g->row * g->column;
+  for (size_t s = 0; s < n; s++) {
+    g->colors[s] = (bits[s / 8] >> (s % 8)) & 1 ? BLACK : WHITE;
+  }
+  game_touch_all(g);
+  game_forget_snapshots(g);
+}
+
+/* ******************** window sums ******************** */
+
+// The grid is copied as one byte per square into a grid surrounded by one
+// halo row and column, filled with the opposite side of the grid when wrapping
+// and left at 0 otherwise. The sum over the window of every square of a row
+// then comes from vertical sums of three padded rows followed by horizontal
+// sums of three lanes (or the five squares of an orthogonal window), a whole
+// vector of squares at a time. Sums past the last column are meaningless.
+typedef struct {
+  uint rows, cols;
+  uint width;   // squares computed per row, a multiple of VECTOR_MAX
+  uint stride;  // bytes per padded row
+  bool wrapping, full, exclude;
+  uint8_t *pad;   // (rows + 2) x stride, square (i, j) at (i+1, j+1)
+  uint8_t *sums;  // stride bytes, vertical sums of the current row
+} window_sums;
+
+static void sums_init(window_sums *w, cgame g) {
+  w->rows = g->row;
+  w->cols = g->column;
+  w->width = (g->column + VECTOR_MAX - 1) / VECTOR_MAX * VECTOR_MAX;
+  w->stride = w->width + 2 * VECTOR_MAX;
+  w->wrapping = g->wrapping;
+  w->full = (g->neigh == FULL || g->neigh == FULL_EXCLUDE);
+  w->exclude = (g->neigh == FULL_EXCLUDE || g->neigh == ORTHO_EXCLUDE);
+  w->pad = calloc((size_t)(w->rows + 2) * w->stride, 1);
+  w->sums = calloc(w->stride, 1);
+  assert(w->pad && w->sums);
+}
+
+static void sums_free(window_sums *w) {
+  free(w->pad);
+  free(w->sums);
+}
+
+static uint8_t *sums_row(window_sums *w, uint i) {
+  return w->pad + (size_t)(i + 1) * w->stride + 1;
+}
+
+// Fills the halo once the rows are written.
+static void sums_halo(window_sums *w) {
+  if (!w->wrapping) return;
+  for (uint i = 0; i < w->rows; i++) {
+    uint8_t *row = sums_row(w, i);
+    row[-1] = row[w->cols - 1];
+    row[w->cols] = row[0];
+  }
+  memcpy(w->pad, w->pad + (size_t)w->rows * w->stride, w->stride);
+  memcpy(w->pad + (size_t)(w->rows + 1) * w->stride, w->pad + w->stride,
+         w->stride);
+}
+
+static void count_row_scalar(window_sums *w, uint i, uint8_t *counts) {
+  const uint8_t *up = w->pad + (size_t)i * w->stride;
+  const uint8_t *mid = up + w->stride, *down = mid + w->stride;
+  if (w->full) {
+    for (uint x = 0; x < w->cols + 2; x++) {
+      w->sums[x] = up[x] + mid[x] + down[x];
+    }
+  }
+  for (uint j = 0; j < w->cols; j++) {
+    uint8_t n;
+    if (w->full) {
+      n = w->sums[j] + w->sums[j + 1] + w->sums[j + 2];
+    } else {
+      n = up[j + 1] + down[j + 1] + mid[j] + mid[j + 1] + mid[j + 2];
+    }
+    if (w->exclude) n -= mid[j + 1];
+    counts[j] = n;
+  }
+}
+
+#ifdef GRID_X86
+#define LOAD128(p) _mm_loadu_si128((const __m128i *)(p))
+#define STORE128(p, x) _mm_storeu_si128((__m128i *)(p), x)
+
+static void count_row_sse2(window_sums *w, uint i, uint8_t *counts) {
+  const uint8_t *up = w->pad + (size_t)i * w->stride;
+  const uint8_t *mid = up + w->stride, *down = mid + w->stride;
+  if (w->full) {
+    for (uint x = 0; x < w->cols + 2; x += 16) {
+      __m128i v = _mm_add_epi8(LOAD128(up + x), LOAD128(mid + x));
+      STORE128(w->sums + x, _mm_add_epi8(v, LOAD128(down + x)));
+    }
+  }
+  for (uint j = 0; j < w->cols; j += 16) {
+    __m128i n;
+    if (w->full) {
+      n = _mm_add_epi8(LOAD128(w->sums + j), LOAD128(w->sums + j + 1));
+      n = _mm_add_epi8(n, LOAD128(w->sums + j + 2));
+    } else {
+      n = _mm_add_epi8(LOAD128(up + j + 1), LOAD128(down + j + 1));
+      n = _mm_add_epi8(n, LOAD128(mid + j));
+      n = _mm_add_epi8(n, LOAD128(mid + j + 1));
+      n = _mm_add_epi8(n, LOAD128(mid + j + 2));
+    }
+    if (w->exclude) n = _mm_sub_epi8(n, LOAD128(mid + j + 1));
+    STORE128(counts + j, n);
+  }
+}
+
+#define LOAD256(p) _mm256_loadu_si256((const __m256i *)(p))
+#define STORE256(p, x) _mm256_storeu_si256((__m256i *)(p), x)
+
+__attribute__((target("avx2"))) static void count_row_avx2(window_sums *w,
+                                                           uint i,
+                                                           uint8_t *counts) {
+  const uint8_t *up = w->pad + (size_t)i * w->stride;
+  const uint8_t *mid = up + w->stride, *down = mid + w->stride;
+  if (w->full) {
+    for (uint x = 0; x < w->cols + 2; x += 32) {
+      __m256i v = _mm256_add_epi8(LOAD256(up + x), LOAD256(mid + x));
+      STORE256(w->sums + x, _mm256_add_epi8(v, LOAD256(down + x)));
+    }
+  }
+  for (uint j = 0; j < w->cols; j += 32) {
+    __m256i n;
+    if (w->full) {
+      n = _mm256_add_epi8(LOAD256(w->sums + j), LOAD256(w->sums + j + 1));
+      n = _mm256_add_epi8(n, LOAD256(w->sums + j + 2));
+    } else {
+      n = _mm256_add_epi8(LOAD256(up + j + 1), LOAD256(down + j + 1));
+      n = _mm256_add_epi8(n, LOAD256(mid + j));
+      n = _mm256_add_epi8(n, LOAD256(mid + j + 1));
+      n = _mm256_add_epi8(n, LOAD256(mid + j + 2));
+    }
+    if (w->exclude) n = _mm256_sub_epi8(n, LOAD256(mid + j + 1));
+    STORE256(counts + j, n);
+  }
+}
+#endif
+
+// Sums of row i into counts (width bytes).
+static void count_row(window_sums *w, uint i, uint8_t *counts,
+                      simd_level level) {
+#ifdef GRID_X86
+  if (level == SIMD_AVX2) {
+    count_row_avx2(w, i, counts);
+  } else if (level == SIMD_SSE2) {
+    count_row_sse2(w, i, counts);
+  } else {
+    count_row_scalar(w, i, counts);
+  }
+#else
+  (void)level;
+  count_row_scalar(w, i, counts);
+#endif
+}
+
+/* ******************** candidate checker ******************** */
+
+// The squares hold 1 for black, so the sums are black counts, compared with
+// the clues of the row under a mask of the constrained squares.
+typedef struct {
+  window_sums grid;
+  uint8_t *clue, *mask;  // rows x width, mask is 0xFF on constrained squares
+  uint8_t *counts;       // width bytes, black counts of the current row
+  uint8_t *line;         // unpacked candidate, row-major without halo
+} checker;
+
+static void checker_init(checker *c, cgame g) {
+  sums_init(&c->grid, g);
+  uint width = c->grid.width;
+  c->clue = calloc((size_t)g->row * width, 1);
+  c->mask = calloc((size_t)g->row * width, 1);
+  c->counts = malloc(width);
+  c->line = malloc((size_t)g->row * g->column + 16);
+  assert(c->clue && c->mask && c->counts && c->line);
+  for (uint i = 0; i < g->row; i++) {
+    for (uint j = 0; j < g->column; j++) {
+      constraint n = g->constraints[i * g->column + j];
+      if (n == UNCONSTRAINED) continue;
+      c->clue[i * width + j] = n;
+      c->mask[i * width + j] = 0xFF;
+    }
+  }
+}
+
+static void checker_free(checker *c) {
+  sums_free(&c->grid);
+  free(c->clue);
+  free(c->mask);
+  free(c->counts);
+  free(c->line);
+}
+
+static void unpack_scalar(const uint8_t *bits, size_t n, uint8_t *out) {
+  for (size_t s = 0; s < n; s++) out[s] = (bits[s / 8] >> (s % 8)) & 1;
+}
+
+#ifdef GRID_X86
+// Spreads two bytes over 16 lanes, then keeps in each lane its own bit.
+static void unpack_sse2(const uint8_t *bits, size_t n, uint8_t *out) {
+  const __m128i sel = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32,
+                                   16, 8, 4, 2, 1);
+  const __m128i one = _mm_set1_epi8(1);
+  size_t b = 0;
+  for (; 8 * b + 16 <= n; b += 2) {
+    __m128i x = _mm_cvtsi32_si128(bits[b] | bits[b + 1] << 8);
+    x = _mm_unpacklo_epi8(x, x);
+    x = _mm_unpacklo_epi16(x, x);
+    x = _mm_unpacklo_epi32(x, x);
+    x = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(x, sel), sel), one);
+    STORE128(out + 8 * b, x);
+  }
+  unpack_scalar(bits + b, n - 8 * b, out + 8 * b);
+}
+#endif
+
+static void checker_load(checker *c, const uint8_t *bits, simd_level level) {
+  window_sums *w = &c->grid;
+  size_t n = (size_t)w->rows * w->cols;
+#ifdef GRID_X86
+  if (level != SIMD_SCALAR) {
+    unpack_sse2(bits, n, c->line);
+  } else {
+    unpack_scalar(bits, n, c->line);
+  }
+#else
+  (void)level;
+  unpack_scalar(bits, n, c->line);
+#endif
+  for (uint i = 0; i < w->rows; i++) {
+    memcpy(sums_row(w, i), c->line + (size_t)i * w->cols, w->cols);
+  }
+  sums_halo(w);
+}
+
+static bool checker_run(checker *c, simd_level level) {
+  window_sums *w = &c->grid;
+  for (uint i = 0; i < w->rows; i++) {
+    const uint8_t *clue = c->clue + (size_t)i * w->width;
+    const uint8_t *mask = c->mask + (size_t)i * w->width;
+    count_row(w, i, c->counts, level);
+#ifdef GRID_X86
+    if (level != SIMD_SCALAR) {
+      __m128i bad = _mm_setzero_si128();
+      for (uint j = 0; j < w->cols; j += 16) {
+        __m128i x = _mm_xor_si128(LOAD128(c->counts + j), LOAD128(clue + j));
+        bad = _mm_or_si128(bad, _mm_and_si128(x, LOAD128(mask + j)));
+      }
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) !=
+          0xFFFF)
+        return false;
+      continue;
+    }
+#endif
+    uint8_t bad = 0;
+    for (uint j = 0; j < w->cols; j++) {
+      bad |= (c->counts[j] ^ clue[j]) & mask[j];
+    }
+    if (bad) return false;
+  }
+  return true;
+}
+
+size_t game_check_solutions(cgame puzzle, const uint8_t *candidates, size_t n,
+                            bool *ok) {
+  assert(puzzle && (candidates || n == 0) && (ok || n == 0));
+  simd_level level = simd_detect();
+  checker c;
+  checker_init(&c, puzzle);
+  size_t size = game_packed_size(puzzle), nb_ok = 0;
+  for (size_t k = 0; k < n; k++) {
+    checker_load(&c, candidates + k * size, level);
+    ok[k] = checker_run(&c, level);
+    nb_ok += ok[k];
+  }
+  checker_free(&c);
+  return nb_ok;
+}
+
+/* ******************** status grid ******************** */
+
+// A square holds 1 if black and 16 if empty, so that a window sum has the
+// black count in its low nibble and the empty count in its high one (both are
+// at most 9). The status follows the rules of game_get_status.
+#define CODE_BLACK 1
+#define CODE_EMPTY 16
+
+static void load_codes_scalar(const color *colors, uint n, uint8_t *codes) {
+  for (uint j = 0; j < n; j++) {
+    codes[j] = (colors[j] == BLACK) * CODE_BLACK +
+               (colors[j] == EMPTY) * CODE_EMPTY;
+  }
+}
+
+static void statuses_scalar(const uint8_t *counts, const constraint *clues,
+                            uint n, status *out) {
+  for (uint j = 0; j < n; j++) {
+    int black = counts[j] & 15, empty = counts[j] >> 4, clue = clues[j];
+    if (clue == UNCONSTRAINED) {
+      out[j] = empty == 0 ? SATISFIED : UNSATISFIED;
+    } else if (black > clue || (black < clue && empty == 0)) {
+      out[j] = ERROR;
+    } else {
+      out[j] = black < clue ? UNSATISFIED : SATISFIED;
+    }
+  }
+}
+
+#ifdef GRID_X86
+// Narrows 16 colors to bytes, then maps them to their codes.
+static void load_codes_sse2(const color *colors, uint n, uint8_t *codes) {
+  const __m128i black = _mm_set1_epi8(BLACK), empty = _mm_set1_epi8(EMPTY);
+  const __m128i code_black = _mm_set1_epi8(CODE_BLACK);
+  const __m128i code_empty = _mm_set1_epi8(CODE_EMPTY);
+  uint j = 0;
+  for (; j + 16 <= n; j += 16) {
+    __m128i a = _mm_packs_epi32(LOAD128(colors + j), LOAD128(colors + j + 4));
+    __m128i b =
+        _mm_packs_epi32(LOAD128(colors + j + 8), LOAD128(colors + j + 12));
+    __m128i x = _mm_packus_epi16(a, b);
+    __m128i code = _mm_and_si128(_mm_cmpeq_epi8(x, black), code_black);
+    code = _mm_or_si128(code,
+                        _mm_and_si128(_mm_cmpeq_epi8(x, empty), code_empty));
+    STORE128(codes + j, code);
+  }
+  load_codes_scalar(colors + j, n - j, codes + j);
+}
+
+// Computes 16 statuses with masks, then widens them to the enumeration.
+static void statuses_sse2(const uint8_t *counts, const constraint *clues,
+                          uint n, status *out) {
+  const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+  const __m128i two = _mm_set1_epi8(2), nibble = _mm_set1_epi8(15);
+  const __m128i unconstrained = _mm_set1_epi8(UNCONSTRAINED);
+  uint j = 0;
+  for (; j + 16 <= n; j += 16) {
+    __m128i a = _mm_packs_epi32(LOAD128(clues + j), LOAD128(clues + j + 4));
+    __m128i b =
+        _mm_packs_epi32(LOAD128(clues + j + 8), LOAD128(clues + j + 12));
+    __m128i clue = _mm_packs_epi16(a, b);
+    __m128i count = LOAD128(counts + j);
+    __m128i black = _mm_and_si128(count, nibble);
+    __m128i empty = _mm_and_si128(_mm_srli_epi16(count, 4), nibble);
+
+    __m128i over = _mm_cmpgt_epi8(black, clue);
+    __m128i under = _mm_cmpgt_epi8(clue, black);
+    __m128i full = _mm_cmpeq_epi8(empty, zero);
+    __m128i error = _mm_or_si128(over, _mm_and_si128(under, full));
+    __m128i unsatisfied = _mm_andnot_si128(full, under);
+    __m128i constrained = _mm_sub_epi8(two, _mm_and_si128(unsatisfied, one));
+    constrained = _mm_sub_epi8(constrained, _mm_and_si128(error, two));
+    __m128i other = _mm_add_epi8(one, _mm_and_si128(full, one));
+    __m128i is_free = _mm_cmpeq_epi8(clue, unconstrained);
+    __m128i st = _mm_or_si128(_mm_and_si128(is_free, other),
+                              _mm_andnot_si128(is_free, constrained));
+
+    __m128i lo = _mm_unpacklo_epi8(st, zero), hi = _mm_unpackhi_epi8(st, zero);
+    STORE128(out + j, _mm_unpacklo_epi16(lo, zero));
+    STORE128(out + j + 4, _mm_unpackhi_epi16(lo, zero));
+    STORE128(out + j + 8, _mm_unpacklo_epi16(hi, zero));
+    STORE128(out + j + 12, _mm_unpackhi_epi16(hi, zero));
+  }
+  statuses_scalar(counts + j, clues + j, n - j, out + j);
+}
+#endif
+
+void game_status_grid(cgame g, status *out) {
+  assert(g && out);
+  simd_level level = simd_detect();
+  window_sums w;
+  sums_init(&w, g);
+  for (uint i = 0; i < w.rows; i++) {
+    const color *colors = g->colors + (size_t)i * w.cols;
+#ifdef GRID_X86
+    if (level != SIMD_SCALAR) {
+      load_codes_sse2(colors, w.cols, sums_row(&w, i));
+      continue;
+    }
+#endif
+    load_codes_scalar(colors, w.cols, sums_row(&w, i));
+  }
+  sums_halo(&w);
+
+  uint8_t *counts = malloc(w.width);
+  assert(counts);
+  for (uint i = 0; i < w.rows; i++) {
+    count_row(&w, i, counts, level);
+    const constraint *clues = g->constraints + (size_t)i * w.cols;
+    status *row = out + (size_t)i * w.cols;
+#ifdef GRID_X86
+    if (level != SIMD_SCALAR) {
+      statuses_sse2(counts, clues, w.cols, row);
+      continue;
+    }
+#endif
+    statuses_scalar(counts, clues, w.cols, row);
+  }
+  free(counts);
+  sums_free(&w);
+}
@@ -0,0 +1,65 @@
+/**
+ * @file grid.h
+ * @brief Whole-grid computations on packed colorings.
+ * @details A packed coloring stores one bit per square in row-major order,
+ * square s being bit (s % 8) of byte s / 8, set for a black square. It takes
+ * @ref game_packed_size bytes. The computations work on whole rows with SSE2
+ * or AVX2 when the processor has them, and fall back to plain C otherwise.
+ * Setting the environment variable GAME_SIMD to "scalar", "sse2" or "avx2"
+ * caps the instruction set used, for testing and benchmarking.
+ **/
+
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+//@{
+
+/** Gets the size in bytes of a packed coloring of @p g. */
+size_t game_packed_size(cgame g);
+
+/**
+ * Packs the colors of @p g into @p bits (of @ref game_packed_size bytes).
+ * Empty squares are packed as white ones.
+ */
+void game_pack(cgame g, uint8_t *bits);
+
+/**
+ * Sets the colors of @p g to the packed coloring @p bits. Like
+ * @ref game_set_color, the move history is not changed.
+ */
+void game_unpack(game g, const uint8_t *bits);
+
+/**
+ * Checks @p n candidate solutions of @p puzzle at once.
+ * @details The candidates are packed colorings stored one after the other.
+ * Candidate k is accepted, and ok[k] set to true, if @ref game_won would hold
+ * for the puzzle colored with it: every clue sees exactly its number of black
+ * squares. The colors of @p puzzle are ignored.
+ * @param puzzle the game giving the clues and options
+ * @param candidates n packed colorings of @ref game_packed_size bytes each
+ * @param n number of candidates
+ * @param ok array of @p n verdicts to fill
+ * @return the number of accepted candidates
+ */
+size_t game_check_solutions(cgame puzzle, const uint8_t *candidates, size_t n,
+                            bool *ok);
+
+/**
+ * Computes the status of every square of @p g at once.
+ * @details out[i * column + j] receives @ref game_get_status (g, i, j). The
+ * windows are summed a whole row at a time from the sums of three rows, which
+ * is much faster than asking square by square on large grids.
+ * @param g the game
+ * @param out array of row x column statuses to fill
+ */
+void game_status_grid(cgame g, status *out);
+
+//@}
+
+#endif
@@ -0,0 +1,97 @@
+#include "kernels.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game_struct.h"
+
+// Offsets of the window squares for a row width w, one X per square.
+#define WINDOW_FULL(X, w) \
+  X(-(w)-1) X(-(w)) X(-(w) + 1) X(-1) X(0) X(1) X((w)-1) X(w) X((w) + 1)
+#define WINDOW_ORTHO(X, w) X(-(w)) X(-1) X(0) X(1) X(w)
+#define WINDOW_FULL_EXCLUDE(X, w) \
+  X(-(w)-1) X(-(w)) X(-(w) + 1) X(-1) X(1) X((w)-1) X(w) X((w) + 1)
+#define WINDOW_ORTHO_EXCLUDE(X, w) X(-(w)) X(-1) X(1) X(w)
+
+#define COUNT_COLOR(d) n += (p[d] == c);
+#define COUNT_BOTH(d)       \
+  black += (p[d] == BLACK); \
+  empty += (p[d] == EMPTY);
+
+// Whether the window of (i, j) stays inside the grid. i - 1 wraps around to
+// UINT_MAX on the first row, and row - 2 on grids of one row.
+static inline bool is_inner(cgame g, uint i, uint j) {
+  return (i - 1u < g->row - 2u) & (j - 1u < g->column - 2u);
+}
+
+static int count_edge(cgame g, uint i, uint j, color c) {
+  uint buffer[9], nb;
+  const uint *squares = neighbor_list(g->neighbors, i, j, buffer, &nb);
+  int n = 0;
+  for (uint k = 0; k < nb; k++) n += (g->colors[squares[k]] == c);
+  return n;
+}
+
+static void count_edge_both(cgame g, uint i, uint j, int *black, int *empty) {
+  uint buffer[9], nb;
+  const uint *squares = neighbor_list(g->neighbors, i, j, buffer, &nb);
+  for (uint k = 0; k < nb; k++) {
+    *black += (g->colors[squares[k]] == BLACK);
+    *empty += (g->colors[squares[k]] == EMPTY);
+  }
+}
+
+// Status by (unconstrained, too many blacks, too few blacks, no empty square),
+// with the rules of game_get_status. Too many and too few cannot both hold.
+static const uint8_t STATUS_TABLE[16] = {
+    // constrained
+    SATISFIED, SATISFIED, UNSATISFIED, ERROR, ERROR, ERROR, ERROR, ERROR,
+    // unconstrained: satisfied once the window has no empty square
+    UNSATISFIED, SATISFIED, UNSATISFIED, SATISFIED, UNSATISFIED, SATISFIED,
+    UNSATISFIED, SATISFIED};
+
+static inline status status_of(constraint n, int black, int empty) {
+  uint index = (n == UNCONSTRAINED) << 3 | (black > (int)n) << 2 |
+               (black < (int)n) << 1 | (empty == 0);
+  return STATUS_TABLE[index];
+}
+
+#define DEFINE_KERNELS(name, WINDOW)                                   \
+  static int nb_neighbors_##name(cgame g, uint i, uint j, color c) {   \
+    if (!is_inner(g, i, j)) return count_edge(g, i, j, c);             \
+    const color *p = g->colors + i * g->column + j;                    \
+    int w = g->column, n = 0;                                          \
+    WINDOW(COUNT_COLOR, w)                                             \
+    return n;                                                          \
+  }                                                                    \
+                                                                       \
+  static status status_##name(cgame g, uint i, uint j) {               \
+    int black = 0, empty = 0;                                          \
+    if (is_inner(g, i, j)) {                                           \
+      const color *p = g->colors + i * g->column + j;                  \
+      int w = g->column;                                               \
+      WINDOW(COUNT_BOTH, w)                                            \
+    } else {                                                           \
+      count_edge_both(g, i, j, &black, &empty);                        \
+    }                                                                  \
+    return status_of(g->constraints[i * g->column + j], black, empty); \
+  }
+
+DEFINE_KERNELS(full, WINDOW_FULL)
+DEFINE_KERNELS(ortho, WINDOW_ORTHO)
+DEFINE_KERNELS(full_exclude, WINDOW_FULL_EXCLUDE)
+DEFINE_KERNELS(ortho_exclude, WINDOW_ORTHO_EXCLUDE)
+
+// In the order of the neighbourhood enumeration.
+static const game_kernels KERNELS[] = {
+    {nb_neighbors_full, status_full},
+    {nb_neighbors_ortho, status_ortho},
+    {nb_neighbors_full_exclude, status_full_exclude},
+    {nb_neighbors_ortho_exclude, status_ortho_exclude},
+};
+
+const game_kernels *game_kernels_select(neighbourhood neigh) {
+  assert(neigh >= FULL && neigh <= ORTHO_EXCLUDE);
+  return &KERNELS[neigh];
+}
@@ -0,0 +1,26 @@
+/**
+ * @file kernels.h
+ * @brief Neighbour counting and status kernels specialized per neighbourhood.
+ * @details Each neighbourhood has its own kernels, selected when the game is
+ * created. Inner squares, whose window never crosses an edge, are counted
+ * with a fixed unrolled window and no test on the options; the squares of
+ * the edges go through the neighbour table (see neighbors.h), which already
+ * handles wrapping. The status is then read from a table instead of a chain
+ * of comparisons.
+ **/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "game.h"
+#include "game_ext.h"
+
+typedef struct game_kernels_s {
+  int (*nb_neighbors)(cgame g, uint i, uint j, color c);
+  status (*status)(cgame g, uint i, uint j);
+} game_kernels;
+
+/** Gets the kernels of a neighbourhood. */
+const game_kernels *game_kernels_select(neighbourhood neigh);
+
+#endif
@@ -7,10 +7,14 @@
 #include <stdio.h>
 
 #include "game_sdl.h"
+#include "trace.h"
 
 /* **************************************************************** */
 
 int main(int argc, char* argv[]) {
+  /* --trace FILE (or GAME_TRACE) records a trace of each frame */
+  trace_parse_args(&argc, argv);
+
   /* initialize SDL2 and some extensions */
   if (SDL_Init(SDL_INIT_VIDEO) != 0)
     ERROR("Error: SDL_Init VIDEO (%s)", SDL_GetError());
@@ -31,25 +35,27 @@ int main(int argc, char* argv[]) {
   /* initialize your environment */
   Env* env = init(win, ren, argc, argv);
 
-  /* main render loop */
+  /* main render loop: sleep until an event arrives, then drain the queue
+   * and redraw once, only if something changed */
   SDL_Event e;
   bool quit = false;
   while (!quit) {
-    /* manage events */
-    while (SDL_PollEvent(&e)) {
-      /* process your events */
-      quit = process(win, ren, env, &e);
-      if (quit) break;
+    if (SDL_WaitEventTimeout(&e, WAIT_TIMEOUT)) {
+      TRACE_BEGIN("events");
+      do {
+        quit = process(win, ren, env, &e);
+      } while (!quit && SDL_PollEvent(&e));
+      TRACE_END("events");
     }
 
-    /* background in gray */
-    SDL_SetRenderDrawColor(ren, 0xA0, 0xA0, 0xA0, 0xFF);
-    SDL_RenderClear(ren);
-
-    /* render all what you want */
-    render(win, ren, env);
-    SDL_RenderPresent(ren);
-    SDL_Delay(DELAY);
+    if (!quit && needs_render(env)) {
+      TRACE_BEGIN("frame");
+      render(win, ren, env);
+      TRACE_BEGIN("present");
+      SDL_RenderPresent(ren);
+      TRACE_END("present");
+      TRACE_END("frame");
+    }
   }
 
   /* clean your environment */
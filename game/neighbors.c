@@ -0,0 +1,183 @@
+#include "neighbors.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Tables unused by any game stay cached, up to this number, so that creating
+// and deleting games one at a time does not rebuild the same table each time.
+#define NEIGHBOR_CACHE_IDLE 4
+
+// The cache is a list ordered from the most recently acquired table. The lock
+// only guards the list and the acquisitions, which are the only way to bring
+// a table back from 0 references: building a table and the references taken
+// by game_copy or dropped by game_delete do not take it.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static neighbor_table *cache = NULL;
+
+static void *checked_malloc(size_t size) {
+  void *p = malloc(size);
+  if (p == NULL) {
+    fprintf(stderr, "Allocation mémoire échouée\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+// Moves of one line (row or column) of the given size: the line at i + d for
+// d in -1, 0, 1, or NO_SQUARE outside the grid.
+static uint *build_steps(uint size, bool wrapping) {
+  uint *step = checked_malloc(3 * size * sizeof(uint));
+  for (uint i = 0; i < size; i++) {
+    for (int d = -1; d <= 1; d++) {
+      long n = (long)i + d;
+      if (wrapping) {
+        n = (n + size) % size;
+      } else if (n < 0 || n >= size) {
+        n = NO_SQUARE;
+      }
+      step[(d + 1) * size + i] = n;
+    }
+  }
+  return step;
+}
+
+uint neighbor_window(const neighbor_table *t, uint i, uint j, uint *squares) {
+  uint nb = 0;
+  for (uint k = 0; k < t->nb_offsets; k++) {
+    uint ni = t->row_step[(t->offset_i[k] + 1) * t->row + i];
+    uint nj = t->col_step[(t->offset_j[k] + 1) * t->column + j];
+    if (ni == NO_SQUARE || nj == NO_SQUARE) continue;
+    squares[nb++] = ni * t->column + nj;
+  }
+  return nb;
+}
+
+static neighbor_table *build_table(uint row, uint column, bool wrapping,
+                                   neighbourhood neigh) {
+  neighbor_table *t = checked_malloc(sizeof(neighbor_table));
+  t->row = row;
+  t->column = column;
+  t->wrapping = wrapping;
+  t->neigh = neigh;
+  t->refs = 1;
+
+  // same window as the one game_nb_neighbors always used
+  bool exclude = (neigh == FULL_EXCLUDE || neigh == ORTHO_EXCLUDE);
+  bool ortho = (neigh == ORTHO || neigh == ORTHO_EXCLUDE);
+  t->nb_offsets = 0;
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      if (exclude && x == 0 && y == 0) continue;
+      if (ortho && x != 0 && y != 0) continue;
+      t->offset_i[t->nb_offsets] = x;
+      t->offset_j[t->nb_offsets++] = y;
+    }
+  }
+  t->row_step = build_steps(row, wrapping);
+  t->col_step = build_steps(column, wrapping);
+
+  t->start = NULL;
+  t->index = NULL;
+  size_t nb_squares = (size_t)row * column;
+  if (nb_squares <= NEIGHBOR_TABLE_MAX) {
+    t->start = checked_malloc((nb_squares + 1) * sizeof(uint));
+    t->index = checked_malloc((nb_squares * t->nb_offsets + 1) * sizeof(uint));
+    uint len = 0;
+    for (uint i = 0; i < row; i++) {
+      for (uint j = 0; j < column; j++) {
+        t->start[i * column + j] = len;
+        len += neighbor_window(t, i, j, t->index + len);
+      }
+    }
+    t->start[nb_squares] = len;
+  }
+  return t;
+}
+
+static void free_table(neighbor_table *t) {
+  free(t->row_step);
+  free(t->col_step);
+  free(t->start);
+  free(t->index);
+  free(t);
+}
+
+// Finds the table of the given shape, moves it to the front of the cache and
+// takes a reference on it. Called with the lock held.
+static neighbor_table *cache_find(uint row, uint column, bool wrapping,
+                                  neighbourhood neigh) {
+  neighbor_table **p = &cache;
+  while (*p && ((*p)->row != row || (*p)->column != column ||
+                (*p)->wrapping != wrapping || (*p)->neigh != neigh)) {
+    p = &(*p)->link;
+  }
+  neighbor_table *t = *p;
+  if (!t) return NULL;
+  *p = t->link;
+  t->link = cache;
+  cache = t;
+  __atomic_add_fetch(&t->refs, 1, __ATOMIC_RELAXED);
+  return t;
+}
+
+// Unlinks the least recently acquired unused tables beyond
+// NEIGHBOR_CACHE_IDLE, and returns them chained by link. Called with the lock
+// held; their references cannot come back from 0 while it is.
+static neighbor_table *cache_evict(void) {
+  neighbor_table *evicted = NULL;
+  uint nb_idle = 0;
+  neighbor_table **p = &cache;
+  while (*p) {
+    neighbor_table *t = *p;
+    bool idle = __atomic_load_n(&t->refs, __ATOMIC_ACQUIRE) == 0;
+    if (idle && ++nb_idle > NEIGHBOR_CACHE_IDLE) {
+      *p = t->link;
+      t->link = evicted;
+      evicted = t;
+    } else {
+      p = &t->link;
+    }
+  }
+  return evicted;
+}
+
+const neighbor_table *neighbor_table_acquire(uint row, uint column,
+                                             bool wrapping,
+                                             neighbourhood neigh) {
+  pthread_mutex_lock(&cache_lock);
+  neighbor_table *t = cache_find(row, column, wrapping, neigh);
+  pthread_mutex_unlock(&cache_lock);
+  if (t) return t;
+
+  // built without the lock; another thread may have inserted the same shape
+  neighbor_table *built = build_table(row, column, wrapping, neigh);
+  pthread_mutex_lock(&cache_lock);
+  t = cache_find(row, column, wrapping, neigh);
+  if (!t) {
+    t = built;
+    t->link = cache;
+    cache = t;
+    built = NULL;
+  }
+  neighbor_table *evicted = cache_evict();
+  pthread_mutex_unlock(&cache_lock);
+
+  if (built) free_table(built);
+  while (evicted) {
+    neighbor_table *next = evicted->link;
+    free_table(evicted);
+    evicted = next;
+  }
+  return t;
+}
+
+const neighbor_table *neighbor_table_ref(const neighbor_table *t) {
+  __atomic_add_fetch(&((neighbor_table *)t)->refs, 1, __ATOMIC_RELAXED);
+  return t;
+}
+
+// The table stays cached once unused, see cache_evict.
+void neighbor_table_release(const neighbor_table *t) {
+  if (t) __atomic_sub_fetch(&((neighbor_table *)t)->refs, 1, __ATOMIC_ACQ_REL);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file neighbors.h
+ * @brief Neighbour tables shared by all the games of the same shape.
+ * @details A table lists, for each square, the squares of its neighbourhood
+ * window (the square itself included unless excluded, a square appearing as
+ * many times as the window reaches it on tiny wrapping grids). The lists are
+ * stored in compressed sparse row form, and the moves of one row or column in
+ * each direction are tabulated, so that neither scanning a window nor stepping
+ * to the next square tests the options or wraps with a modulo. Tables are
+ * reference counted and cached by (rows, columns, wrapping, neighbourhood);
+ * a few unused tables stay cached for the next games of their shape.
+ **/
+
+#ifndef NEIGHBORS_H
+#define NEIGHBORS_H
+
+#include <stdbool.h>
+
+#include "game.h"
+#include "game_ext.h"
+
+#define NEIGHBOR_TABLE_MAX (1u << 20)  // largest grid with compressed lists
+#define NO_SQUARE ((uint)-1)
+
+typedef struct neighbor_table_s {
+  uint row, column;
+  bool wrapping;
+  neighbourhood neigh;
+  uint nb_offsets;  // size of the window
+  int offset_i[9], offset_j[9];
+  uint *row_step;  // row_step[(d + 1) * row + i]: row i + d, or NO_SQUARE
+  uint *col_step;  // col_step[(d + 1) * column + j]: column j + d, or NO_SQUARE
+  uint *start;     // neighbours of s: index[start[s]] ... index[start[s+1] - 1]
+  uint *index;     // NULL above NEIGHBOR_TABLE_MAX squares (9 uint per square)
+  int refs;  // atomic, 0 while cached without users
+  struct neighbor_table_s *link;  // next table of the cache
+} neighbor_table;
+
+/** Gets the table of the given shape, building it if no game uses it yet. */
+const neighbor_table *neighbor_table_acquire(uint row, uint column,
+                                             bool wrapping,
+                                             neighbourhood neigh);
+
+/** Adds a reference to @p t and returns it, without taking a lock. */
+const neighbor_table *neighbor_table_ref(const neighbor_table *t);
+
+/** Drops a reference to @p t (which may be NULL), without taking a lock. */
+void neighbor_table_release(const neighbor_table *t);
+
+/**
+ * Writes the window of square (@p i, @p j) into @p squares (9 entries) from
+ * the row and column steps, and returns its size. Used above
+ * NEIGHBOR_TABLE_MAX squares, see @ref neighbor_list.
+ */
+uint neighbor_window(const neighbor_table *t, uint i, uint j, uint *squares);
+
+/**
+ * Gets the window of square (@p i, @p j) and its size in @p nb. The list is
+ * read from the table, or written into @p buffer (9 entries) on the largest
+ * grids.
+ */
+static inline const uint *neighbor_list(const neighbor_table *t, uint i,
+                                        uint j, uint *buffer, uint *nb) {
+  if (t->index) {
+    uint s = i * t->column + j;
+    *nb = t->start[s + 1] - t->start[s];
+    return t->index + t->start[s];
+  }
+  *nb = neighbor_window(t, i, j, buffer);
+  return buffer;
+}
+
+#endif
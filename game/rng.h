@@ -0,0 +1,40 @@
+/**
+ * @file rng.h
+ * @brief Reentrant pseudo-random number generator (xoshiro256**).
+ * @details Every generator keeps its own state, so several threads can draw
+ * numbers at the same time without any lock, and a sequence is fully
+ * determined by its seed. For further details, please visit :
+ * https://prng.di.unimi.it/
+ **/
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+//@{
+
+/** Generator state. */
+typedef struct rng_s {
+  uint64_t s[4];
+} rng;
+
+/** Initializes the generator from a 64-bit seed. */
+void rng_seed(rng *r, uint64_t seed);
+
+/** Returns the next 64-bit number of the sequence. */
+uint64_t rng_next(rng *r);
+
+/** Returns a number uniformly distributed in [0, 1). */
+float rng_float(rng *r);
+
+/** Returns a number uniformly distributed in [0, n), with n > 0. */
+uint32_t rng_uniform(rng *r, uint32_t n);
+
+/** Advances the generator by 2^128 steps. Calling it k times on copies of the
+ * same generator gives k non-overlapping streams, e.g. one per thread. */
+void rng_jump(rng *r);
+
+//@}
+
+#endif
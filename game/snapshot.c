@@ -0,0 +1,309 @@
+#include "snapshot.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_struct.h"
+
+#define TILE_SIDE 8  // a tile holds TILE_SIDE x TILE_SIDE squares
+#define TILE_SIZE (TILE_SIDE * TILE_SIDE)
+#define NODE_BITS 5  // a node of the tree has 2^NODE_BITS children
+#define NODE_SIZE (1u << NODE_BITS)
+
+// Tiles and nodes start with their reference count, so that they can be
+// shared and released the same way. The tree has depth levels of nodes above
+// the tiles; tile t is reached by the digits of t in base NODE_SIZE.
+typedef struct {
+  int refs;
+} shared;
+
+typedef struct {
+  shared header;
+  uint8_t colors[TILE_SIZE];  // row-major, squares outside the grid are EMPTY
+} tile;
+
+typedef struct {
+  shared header;
+  void *children[NODE_SIZE];  // NULL past the last tile
+} node;
+
+struct snapshot_s {
+  int refs;
+  uint row, column;
+  uint tile_cols;  // number of tiles in a row of tiles
+  uint nb_tiles;
+  uint depth;  // levels of nodes above the tiles, 0 if the root is a tile
+  void *root;
+};
+
+/* ******************** reference counting ******************** */
+
+static void *retain(void *p) {
+  if (p) __atomic_add_fetch(&((shared *)p)->refs, 1, __ATOMIC_RELAXED);
+  return p;
+}
+
+static bool unique(void *p) {
+  return __atomic_load_n(&((shared *)p)->refs, __ATOMIC_ACQUIRE) == 1;
+}
+
+static void release(void *p, uint level) {
+  if (!p || __atomic_sub_fetch(&((shared *)p)->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    return;
+  if (level > 0) {
+    node *n = p;
+    for (uint k = 0; k < NODE_SIZE; k++) release(n->children[k], level - 1);
+  }
+  free(p);
+}
+
+snapshot snapshot_ref(snapshot s) {
+  __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+  return s;
+}
+
+void snapshot_release(snapshot s) {
+  if (!s || __atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+  release(s->root, s->depth);
+  free(s);
+}
+
+/* ******************** tiles ******************** */
+
+static void *alloc_shared(size_t size) {
+  shared *p = malloc(size);
+  assert(p);
+  p->refs = 1;
+  return p;
+}
+
+static uint tile_index(snapshot s, uint i, uint j) {
+  return (i / TILE_SIDE) * s->tile_cols + j / TILE_SIDE;
+}
+
+static uint child_index(uint t, uint level) {
+  return (t >> (NODE_BITS * (level - 1))) & (NODE_SIZE - 1);
+}
+
+static tile *find_tile(snapshot s, uint t) {
+  void *p = s->root;
+  for (uint level = s->depth; level > 0; level--) {
+    p = ((node *)p)->children[child_index(t, level)];
+  }
+  return p;
+}
+
+// Copies the squares of tile t between the colors of g and a tile.
+static void load_tile(tile *tl, snapshot s, cgame g, uint t) {
+  uint i0 = (t / s->tile_cols) * TILE_SIDE, j0 = (t % s->tile_cols) * TILE_SIDE;
+  memset(tl->colors, EMPTY, TILE_SIZE);
+  for (uint i = i0; i < i0 + TILE_SIDE && i < g->row; i++) {
+    for (uint j = j0; j < j0 + TILE_SIDE && j < g->column; j++) {
+      tl->colors[(i - i0) * TILE_SIDE + j - j0] = g->colors[i * g->column + j];
+    }
+  }
+}
+
+static void store_tile(const tile *tl, snapshot s, game g, uint t) {
+  uint i0 = (t / s->tile_cols) * TILE_SIDE, j0 = (t % s->tile_cols) * TILE_SIDE;
+  for (uint i = i0; i < i0 + TILE_SIDE && i < g->row; i++) {
+    for (uint j = j0; j < j0 + TILE_SIDE && j < g->column; j++) {
+      g->colors[i * g->column + j] = tl->colors[(i - i0) * TILE_SIDE + j - j0];
+    }
+  }
+}
+
+static bool same_tile(const tile *tl, snapshot s, cgame g, uint t) {
+  uint i0 = (t / s->tile_cols) * TILE_SIDE, j0 = (t % s->tile_cols) * TILE_SIDE;
+  for (uint i = i0; i < i0 + TILE_SIDE && i < g->row; i++) {
+    for (uint j = j0; j < j0 + TILE_SIDE && j < g->column; j++) {
+      if (tl->colors[(i - i0) * TILE_SIDE + j - j0] !=
+          g->colors[i * g->column + j])
+        return false;
+    }
+  }
+  return true;
+}
+
+/* ******************** tree ******************** */
+
+// Builds the subtree of the given level whose first tile is t.
+static void *build(snapshot s, cgame g, uint level, uint t) {
+  if (level == 0) {
+    tile *tl = alloc_shared(sizeof(tile));
+    load_tile(tl, s, g, t);
+    return tl;
+  }
+  node *n = alloc_shared(sizeof(node));
+  uint span = 1u << (NODE_BITS * (level - 1));  // tiles under each child
+  for (uint k = 0; k < NODE_SIZE; k++) {
+    uint first = t + k * span;
+    n->children[k] = first < s->nb_tiles ? build(s, g, level - 1, first) : NULL;
+  }
+  return n;
+}
+
+// Takes ownership of the reference p and returns a reference to a subtree
+// with the same contents in which tile t and the path to it are owned by the
+// caller only, copying the shared ones. The tile is returned in leaf.
+static void *unshare_path(void *p, uint level, uint t, tile **leaf) {
+  if (level == 0) {
+    tile *tl = p;
+    if (!unique(tl)) {
+      tile *copy = alloc_shared(sizeof(tile));
+      memcpy(copy->colors, tl->colors, TILE_SIZE);
+      release(tl, 0);
+      tl = copy;
+    }
+    *leaf = tl;
+    return tl;
+  }
+  node *n = p;
+  if (!unique(n)) {
+    node *copy = alloc_shared(sizeof(node));
+    for (uint k = 0; k < NODE_SIZE; k++) {
+      copy->children[k] = retain(n->children[k]);
+    }
+    release(n, level);
+    n = copy;
+  }
+  uint k = child_index(t, level);
+  n->children[k] = unshare_path(n->children[k], level - 1, t, leaf);
+  return n;
+}
+
+static snapshot new_snapshot(cgame g) {
+  snapshot s = malloc(sizeof(struct snapshot_s));
+  assert(s);
+  s->refs = 1;
+  s->row = g->row;
+  s->column = g->column;
+  s->tile_cols = (g->column + TILE_SIDE - 1) / TILE_SIDE;
+  s->nb_tiles = ((g->row + TILE_SIDE - 1) / TILE_SIDE) * s->tile_cols;
+  s->depth = 0;
+  while ((1ull << (NODE_BITS * s->depth)) < s->nb_tiles) s->depth++;
+  s->root = build(s, g, s->depth, 0);
+  return s;
+}
+
+// Returns a snapshot with the same contents as s that the caller owns alone.
+static snapshot unshare(snapshot s) {
+  if (__atomic_load_n(&s->refs, __ATOMIC_ACQUIRE) == 1) return s;
+  snapshot copy = malloc(sizeof(struct snapshot_s));
+  assert(copy);
+  *copy = *s;
+  copy->refs = 1;
+  copy->root = retain(s->root);
+  snapshot_release(s);
+  return copy;
+}
+
+/* ******************** game versions ******************** */
+
+void game_mark_dirty(game g, uint index) {
+  uint t = tile_index(g->version, index / g->column, index % g->column);
+  if (g->nb_dirty == ALL_DIRTY || g->dirty[t]) return;
+  g->dirty[t] = true;
+  g->dirty_list[g->nb_dirty++] = t;
+}
+
+// Brings the last snapshot of g up to date with its colors.
+static void refresh_version(game g) {
+  if (!g->version) {
+    g->version = new_snapshot(g);
+    g->dirty = calloc(g->version->nb_tiles, sizeof(bool));
+    g->dirty_list = malloc(g->version->nb_tiles * sizeof(uint));
+    assert(g->dirty && g->dirty_list);
+    g->nb_dirty = 0;
+    return;
+  }
+  if (g->nb_dirty == 0) return;
+
+  // the tiles written since the last snapshot are copied into a new version,
+  // or updated in place if nobody else holds the last one
+  snapshot s = unshare(g->version);
+  bool all = (g->nb_dirty == ALL_DIRTY);
+  uint nb = all ? s->nb_tiles : g->nb_dirty;
+  for (uint k = 0; k < nb; k++) {
+    uint t = all ? k : g->dirty_list[k];
+    g->dirty[t] = false;
+    if (same_tile(find_tile(s, t), s, g, t)) continue;
+    tile *tl;
+    s->root = unshare_path(s->root, s->depth, t, &tl);
+    load_tile(tl, s, g, t);
+  }
+  g->version = s;
+  g->nb_dirty = 0;
+}
+
+snapshot game_snapshot(game g) {
+  refresh_version(g);
+  return snapshot_ref(g->version);
+}
+
+// Copies into g the tiles that differ between two trees of the same shape.
+static void store_diff(game g, snapshot s, void *old, void *new, uint level,
+                       uint t) {
+  if (old == new || !new) return;
+  if (level == 0) {
+    store_tile(new, s, g, t);
+    return;
+  }
+  uint span = 1u << (NODE_BITS * (level - 1));
+  for (uint k = 0; k < NODE_SIZE; k++) {
+    store_diff(g, s, ((node *)old)->children[k], ((node *)new)->children[k],
+               level - 1, t + k * span);
+  }
+}
+
+void game_restore_snapshot(game g, snapshot s) {
+  assert(s->row == g->row && s->column == g->column);
+  snapshot old = g->version;
+  if (!old || g->nb_dirty == ALL_DIRTY) {
+    for (uint t = 0; t < s->nb_tiles; t++) store_tile(find_tile(s, t), s, g, t);
+  } else {
+    // the colors match the last snapshot except in the dirty tiles
+    for (uint k = 0; k < g->nb_dirty; k++) {
+      store_tile(find_tile(s, g->dirty_list[k]), s, g, g->dirty_list[k]);
+    }
+    store_diff(g, s, old->root, s->root, s->depth, 0);
+  }
+  if (!g->dirty) {
+    g->dirty = calloc(s->nb_tiles, sizeof(bool));
+    g->dirty_list = malloc(s->nb_tiles * sizeof(uint));
+    assert(g->dirty && g->dirty_list);
+  }
+  if (g->nb_dirty == ALL_DIRTY) {
+    memset(g->dirty, 0, s->nb_tiles * sizeof(bool));
+  } else {
+    for (uint k = 0; k < g->nb_dirty; k++) g->dirty[g->dirty_list[k]] = false;
+  }
+  g->nb_dirty = 0;
+  g->version = snapshot_ref(s);
+  snapshot_release(old);
+  game_forget_snapshots(g);
+}
+
+/* ******************** versions ******************** */
+
+color snapshot_get_color(snapshot s, uint i, uint j) {
+  assert(i < s->row && j < s->column);
+  tile *tl = find_tile(s, tile_index(s, i, j));
+  return tl->colors[(i % TILE_SIDE) * TILE_SIDE + j % TILE_SIDE];
+}
+
+snapshot snapshot_set_color(snapshot s, uint i, uint j, color c) {
+  assert(i < s->row && j < s->column);
+  snapshot copy = malloc(sizeof(struct snapshot_s));
+  assert(copy);
+  *copy = *s;
+  copy->refs = 1;
+  tile *tl;
+  copy->root =
+      unshare_path(retain(s->root), s->depth, tile_index(s, i, j), &tl);
+  tl->colors[(i % TILE_SIDE) * TILE_SIDE + j % TILE_SIDE] = c;
+  return copy;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file snapshot.h
+ * @brief Persistent (copy-on-write) versions of the colors of a game.
+ * @details The colors are cut into square tiles shared by reference count
+ * between all the versions that contain them, under a tree of fixed fan-out.
+ * A version is never modified: @ref snapshot_set_color returns a new version
+ * that only copies the tile of the square and the path of the tree leading to
+ * it, so thousands of near-identical boards cost memory proportional to their
+ * differences. A game keeps track of the tiles written since its last
+ * snapshot, which makes @ref game_snapshot O(1) when nothing changed and
+ * O(tile) per modified tile otherwise. Versions can be shared between threads.
+ **/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "game.h"
+
+//@{
+
+/** An immutable version of the colors of a game. */
+typedef struct snapshot_s *snapshot;
+
+/**
+ * Returns the current colors of @p g as a new reference, to release with
+ * @ref snapshot_release. The constraints and options are not part of it.
+ * The game keeps its last snapshot and the tiles written since then, which
+ * this call updates: like any other change to @p g, it must not run while
+ * another thread uses the same game.
+ */
+snapshot game_snapshot(game g);
+
+/**
+ * Sets the colors of @p g to those of @p s, which must have the same size.
+ * Only the tiles that differ from the last snapshot of @p g are copied. Like
+ * @ref game_set_color, the move history is not changed.
+ */
+void game_restore_snapshot(game g, snapshot s);
+
+/** Adds a reference to @p s and returns it. */
+snapshot snapshot_ref(snapshot s);
+
+/** Drops a reference to @p s (which may be NULL). */
+void snapshot_release(snapshot s);
+
+/** Gets the color of square (@p i, @p j) in @p s. */
+color snapshot_get_color(snapshot s, uint i, uint j);
+
+/**
+ * Returns a new version equal to @p s except for the color of square
+ * (@p i, @p j), as a new reference. @p s is unchanged.
+ */
+snapshot snapshot_set_color(snapshot s, uint i, uint j, color c);
+
+//@}
+
+#endif
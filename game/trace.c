@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_CAPACITY 65536  // events kept per thread (a power of two)
+
+#if defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct {
+  const char *name;
+  uint64_t ts;  // nanoseconds since trace_init
+  char phase;   // 'B' or 'E'
+} trace_event;
+
+// Only the owning thread writes to its buffer. When the thread exits, its
+// buffer goes to a free list and is handed to the next thread that records
+// an event, which appends to the same ring under the same tid: the events of
+// exited threads are still written at exit, and programs that start threads
+// in batches only keep as many buffers as they run threads at once.
+typedef struct trace_buffer_s {
+  trace_event events[TRACE_CAPACITY];
+  uint64_t nb_events;  // total recorded, the ring keeps the last ones
+  unsigned int tid;
+  struct trace_buffer_s *next;       // all the buffers
+  struct trace_buffer_s *next_free;  // buffers of exited threads
+} trace_buffer;
+
+bool trace_enabled = false;
+
+static char *trace_file = NULL;
+static uint64_t trace_start;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer *trace_buffers = NULL;
+static trace_buffer *trace_free = NULL;
+static pthread_key_t trace_key;  // the buffer of the thread, see trace_release
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static unsigned int trace_nb_threads = 0;
+static THREAD_LOCAL trace_buffer *local = NULL;
+
+/* *********************************************************** */
+
+static uint64_t trace_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* *********************************************************** */
+
+void trace_init(const char *filename) {
+  if (trace_enabled) return;
+  if (!filename) filename = getenv("GAME_TRACE");
+  if (!filename || !*filename) return;
+  trace_file = strdup(filename);
+  if (!trace_file) return;
+  trace_start = trace_now();
+  atexit(trace_flush);
+  trace_enabled = true;
+}
+
+/* *********************************************************** */
+
+void trace_parse_args(int *argc, char *argv[]) {
+  const char *filename = NULL;
+  int nb_args = 0;
+  for (int i = 0; i < *argc; i++) {
+    if (i > 0 && strcmp(argv[i], "--trace") == 0 && i + 1 < *argc) {
+      filename = argv[++i];
+    } else if (i > 0 && strncmp(argv[i], "--trace=", 8) == 0) {
+      filename = argv[i] + 8;
+    } else {
+      argv[nb_args++] = argv[i];
+    }
+  }
+  argv[nb_args] = NULL;
+  *argc = nb_args;
+  trace_init(filename);
+}
+
+/* *********************************************************** */
+
+// Destructor of trace_key, run when a thread that recorded events exits.
+static void trace_release(void *data) {
+  trace_buffer *buf = data;
+  local = NULL;  // a later destructor may still record, in a new buffer
+  pthread_mutex_lock(&trace_lock);
+  buf->next_free = trace_free;
+  trace_free = buf;
+  pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_create_key(void) {
+  pthread_key_create(&trace_key, trace_release);
+}
+
+static trace_buffer *trace_register(void) {
+  pthread_once(&trace_key_once, trace_create_key);
+  pthread_mutex_lock(&trace_lock);
+  trace_buffer *buf = trace_free;
+  if (buf) {
+    trace_free = buf->next_free;
+  } else {
+    buf = malloc(sizeof(trace_buffer));
+    if (buf) {
+      buf->nb_events = 0;
+      buf->tid = trace_nb_threads++;
+      buf->next = trace_buffers;
+      trace_buffers = buf;
+    }
+  }
+  pthread_mutex_unlock(&trace_lock);
+  if (buf) pthread_setspecific(trace_key, buf);
+  return buf;
+}
+
+static void trace_record(const char *name, char phase) {
+  if (!local) local = trace_register();
+  if (!local) return;
+  trace_event *e = &local->events[local->nb_events % TRACE_CAPACITY];
+  e->name = name;
+  e->ts = trace_now() - trace_start;
+  e->phase = phase;
+  local->nb_events++;
+}
+
+void trace_begin(const char *name) { trace_record(name, 'B'); }
+
+void trace_end(const char *name) { trace_record(name, 'E'); }
+
+/* *********************************************************** */
+
+void trace_flush(void) {
+  if (!trace_enabled) return;
+  FILE *f = fopen(trace_file, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot open trace file %s\n", trace_file);
+    return;
+  }
+  int pid = getpid();
+  bool first = true;
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  pthread_mutex_lock(&trace_lock);
+  for (trace_buffer *buf = trace_buffers; buf; buf = buf->next) {
+    uint64_t end = buf->nb_events;
+    uint64_t begin = end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0;
+    // once the ring has wrapped, skip the ends of phases begun before it
+    unsigned int depth = 0;
+    for (uint64_t n = begin; n < end; n++) {
+      const trace_event *e = &buf->events[n % TRACE_CAPACITY];
+      if (e->phase == 'E' && depth == 0) continue;
+      depth += (e->phase == 'B') ? 1 : -1;
+      fprintf(f,
+              "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, "
+              "\"pid\": %d, \"tid\": %u}",
+              first ? "" : ",", e->name, e->phase, e->ts / 1000.0, pid,
+              buf->tid);
+      first = false;
+    }
+  }
+  pthread_mutex_unlock(&trace_lock);
+  fprintf(f, "\n]}\n");
+  fclose(f);
+}
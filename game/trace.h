@@ -0,0 +1,70 @@
+/**
+ * @file trace.h
+ * @brief Lightweight tracing in the Chrome trace-event format.
+ * @details Phases are delimited with @ref TRACE_BEGIN / @ref TRACE_END, or
+ * with @ref TRACE_SCOPE which ends the phase when the enclosing block exits.
+ * Events are recorded in per-thread ring buffers and written as JSON when the
+ * program exits; the file can be opened in chrome://tracing or
+ * https://ui.perfetto.dev. When tracing is disabled, each macro only costs the
+ * test of a global flag.
+ **/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+//@{
+
+/** True once @ref trace_init enabled tracing. */
+extern bool trace_enabled;
+
+/**
+ * Enables tracing to @p filename, or to the file named by the GAME_TRACE
+ * environment variable if @p filename is NULL. Does nothing if neither is
+ * given. The trace is written at exit.
+ */
+void trace_init(const char *filename);
+
+/**
+ * Removes the "--trace FILE" (or "--trace=FILE") option from the command line
+ * and calls @ref trace_init with it, so GAME_TRACE is used when it is absent.
+ */
+void trace_parse_args(int *argc, char *argv[]);
+
+/** Starts a phase. @p name must be a string literal. */
+void trace_begin(const char *name);
+
+/** Ends the last phase started by the calling thread. */
+void trace_end(const char *name);
+
+/** Writes all recorded events to the trace file (called at exit). */
+void trace_flush(void);
+
+#define TRACE_BEGIN(name)                 \
+  do {                                    \
+    if (trace_enabled) trace_begin(name); \
+  } while (0)
+
+#define TRACE_END(name)                 \
+  do {                                  \
+    if (trace_enabled) trace_end(name); \
+  } while (0)
+
+#if defined(__GNUC__)
+static inline void trace_scope_end(const char **name) {
+  if (*name) trace_end(*name);
+}
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)                                               \
+  const char *TRACE_CONCAT(trace_scope_, __LINE__)                      \
+      __attribute__((cleanup(trace_scope_end))) =                       \
+          trace_enabled ? (trace_begin(name), (name)) : (const char *)0
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+//@}
+
+#endif
@@ -51,11 +51,25 @@ function printGame(g,cellWidth,cellHeight,ctx) {
  
  var nb_rows = Module._nb_rows(g);
  var nb_cols = Module._nb_cols(g);
+ // a single call packs the whole board in wasm memory (see export_board in
+ // wrapper.c); the view is taken afterwards since memory may have grown.
+ // Older builds without export_board, or a failed allocation (0), fall back
+ // to one call per square.
+ var ptr = Module._export_board && Module.HEAPU8 ? Module._export_board(g) : 0;
+ var board = ptr ? Module.HEAPU8.subarray(ptr, ptr + Module._export_board_length()) : null;
  for (var row = 0; row < nb_rows; row++) {
  for (var col = 0; col < nb_cols; col++) {
- var n = Module._get_constraint(g, row, col);
- var c = Module._get_color(g, row, col);
- var status = Module._get_status(g, row, col);
+ var n, c, status;
+ if (board) {
+ var cell = board[row * nb_cols + col];
+ n = (cell & 0x0F) == 0x0F ? UNCONSTRAINED : cell & 0x0F;
+ c = (cell >> 4) & 0x03;
+ status = cell >> 6;
+ } else {
+ n = Module._get_constraint(g, row, col);
+ c = Module._get_color(g, row, col);
+ status = Module._get_status(g, row, col);
+ }
  setGridItem(row,col,c,ctx,cellWidth,cellHeight,n,status)
  }
  
@@ -209,15 +209,26 @@ uint game_nb_solutions(cgame g) {
 
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
                  bool with_solution, float black_rate, float constraint_rate) {
+  // keep honouring srand() for the callers of the historical interface
+  rng r;
+  rng_seed(&r, rand());
+  return game_random_r(nb_rows, nb_cols, wrapping, neigh, with_solution,
+                       black_rate, constraint_rate, &r);
+}
+
+game game_random_r(uint nb_rows, uint nb_cols, bool wrapping,
+                   neighbourhood neigh, bool with_solution, float black_rate,
+                   float constraint_rate, rng *state) {
   assert(black_rate >= 0.0f && black_rate <= 1.0f);
   assert(constraint_rate >= 0.0f && constraint_rate <= 1.0f);
+  assert(state);
   game g = game_new_empty_ext(nb_rows, nb_cols, wrapping, neigh);
   assert(g);
 
   // fill the grid with random colors
   for (uint i = 0; i < nb_rows; i++) {
     for (uint j = 0; j < nb_cols; j++) {
-      color c = (rand() < black_rate * (float)RAND_MAX) ? BLACK : WHITE;
+      color c = (rng_float(state) < black_rate) ? BLACK : WHITE;
       game_set_color(g, i, j, c);
     }
   }
@@ -226,8 +237,8 @@ game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
   uint nb_squares = nb_rows * nb_cols;
   uint nb_constraints = constraint_rate * nb_squares;
   for (uint i = 0; i < nb_constraints; i++) {
-    uint row = rand() % nb_rows;
-    uint col = rand() % nb_cols;
+    uint row = rng_uniform(state, nb_rows);
+    uint col = rng_uniform(state, nb_cols);
     int nb_blacks = game_nb_neighbors(g, row, col, BLACK);
     game_set_constraint(g, row, col, nb_blacks);
   }
@@ -240,4 +251,4 @@ game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
 
   if (!with_solution) game_restart(g);
   return g;
-}
\ No newline at end of file
+}
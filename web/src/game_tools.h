@@ -13,6 +13,7 @@
 
 #include "game.h"
 #include "game_struct.h"
+#include "rng.h"
 
 /**
  * @name Game Tools
@@ -52,9 +53,29 @@ bool game_solve(game g);
  */
 uint game_nb_solutions(cgame g);
 
+/**
+ * @brief Creates a random game drawn from the global rand() stream.
+ * @details Equivalent to @ref game_random_r with a generator seeded from
+ * rand(), so that srand() still controls the result.
+ * @return the created game, or NULL if it could not be built
+ */
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
                  bool with_solution, float black_rate, float constraint_rate);
 
+/**
+ * @brief Creates a random game drawn from an explicit generator.
+ * @details The grid is first filled with black squares (with probability
+ * @p black_rate) and white squares, then about @p constraint_rate of the
+ * squares receive the constraint matching this coloring. This function is
+ * reentrant: games built from generators seeded the same way are identical.
+ * @param state the random generator, updated by the call
+ * @return the created game (solved if @p with_solution), or NULL if it could
+ * not be built
+ */
+game game_random_r(uint nb_rows, uint nb_cols, bool wrapping,
+                   neighbourhood neigh, bool with_solution, float black_rate,
+                   float constraint_rate, rng* state);
+
 /**
  *
  *
@@ -0,0 +1,75 @@
+#include "rng.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+/* *********************************************************** */
+
+static inline uint64_t rotl(const uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+/* *********************************************************** */
+
+void rng_seed(rng *r, uint64_t seed) {
+  assert(r);
+  // expand the seed with splitmix64, as advised by the xoshiro authors
+  for (int n = 0; n < 4; n++) {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    r->s[n] = z ^ (z >> 31);
+  }
+}
+
+/* *********************************************************** */
+
+uint64_t rng_next(rng *r) {
+  uint64_t *s = r->s;
+  const uint64_t result = rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+/* *********************************************************** */
+
+float rng_float(rng *r) { return (rng_next(r) >> 40) * 0x1.0p-24f; }
+
+/* *********************************************************** */
+
+uint32_t rng_uniform(rng *r, uint32_t n) {
+  assert(n > 0);
+  // multiply-shift reduction, no modulo bias worth mentioning for 32-bit n
+  return (uint32_t)(((rng_next(r) >> 32) * (uint64_t)n) >> 32);
+}
+
+/* *********************************************************** */
+
+void rng_jump(rng *r) {
+  static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                  0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (JUMP[i] & (UINT64_C(1) << b)) {
+        s0 ^= r->s[0];
+        s1 ^= r->s[1];
+        s2 ^= r->s[2];
+        s3 ^= r->s[3];
+      }
+      rng_next(r);
+    }
+  }
+  r->s[0] = s0;
+  r->s[1] = s1;
+  r->s[2] = s2;
+  r->s[3] = s3;
+}
+
+/* *********************************************************** */
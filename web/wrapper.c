@@ -7,6 +7,7 @@
 
 #include <emscripten.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -53,6 +54,47 @@ void undo(game g) { game_undo(g); }
 EMSCRIPTEN_KEEPALIVE
 void redo(game g) { game_redo(g); }
 
+/* ******************** Bulk Board Export ******************** */
+
+// One byte per square, in row-major order:
+//   bits 0-3: constraint (15 for UNCONSTRAINED)
+//   bits 4-5: color
+//   bits 6-7: status
+// The buffer lives in the wasm memory, so JS reads it through a HEAPU8 view
+// instead of calling get_constraint, get_color and get_status per square.
+static uint8_t *board_buffer = NULL;
+static uint board_capacity = 0;
+static uint board_length = 0;
+
+EMSCRIPTEN_KEEPALIVE
+uint8_t *export_board(cgame g)
+{
+    uint nb_rows = game_nb_rows(g), nb_cols = game_nb_cols(g);
+    board_length = nb_rows * nb_cols;
+    if (board_length > board_capacity) {
+        free(board_buffer);
+        board_buffer = malloc(board_length);
+        board_capacity = board_buffer ? board_length : 0;
+        if (!board_buffer) {
+            board_length = 0;
+            return NULL;
+        }
+    }
+    uint8_t *cell = board_buffer;
+    for (uint i = 0; i < nb_rows; i++) {
+        for (uint j = 0; j < nb_cols; j++) {
+            constraint n = game_get_constraint(g, i, j);
+            *cell++ = (n == UNCONSTRAINED ? 0x0F : n) |
+                      (game_get_color(g, i, j) << 4) |
+                      (game_get_status(g, i, j) << 6);
+        }
+    }
+    return board_buffer;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint export_board_length(void) { return board_length; }
+
 /* ******************** Game Tools API ******************** */
 
 EMSCRIPTEN_KEEPALIVE
@@ -61,12 +103,23 @@ bool solve(game g) { return game_solve(g); }
 EMSCRIPTEN_KEEPALIVE
 uint nb_solutions(cgame g) { return game_nb_solutions(g); }
 
+static rng random_state;
+static bool random_seeded = false;
+
+EMSCRIPTEN_KEEPALIVE
+void seed_random(double seed)
+{
+    rng_seed(&random_state, (uint64_t)seed);
+    random_seeded = true;
+}
+
 EMSCRIPTEN_KEEPALIVE
 game new_random(uint nb_rows, uint nb_cols, bool wrapping, neighbourhood neigh,
                 float black_rate, float constraint_rate)
 {
-    srand(time(NULL)); // random seed
-    return game_random(nb_rows, nb_cols, wrapping, neigh, false, black_rate, constraint_rate);
+    if (!random_seeded) seed_random(time(NULL)); // seeded once, then reused
+    return game_random_r(nb_rows, nb_cols, wrapping, neigh, false, black_rate,
+                         constraint_rate, &random_state);
 }
 
 // EOF